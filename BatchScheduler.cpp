@@ -0,0 +1,109 @@
+#include "BatchScheduler.h"
+#include "Platform.h"
+#include <algorithm>
+#include <chrono>
+
+
+uint64_t estimateJobMemory(const LVLContents& contents, const ConvertOptions& options)
+{
+    // the converter itself, independent of the LVL
+    constexpr uint64_t BASE_BYTES = 64 * 1024 * 1024;
+
+    // from converting the stock maps: decoded mip chains take about 4 to 8 times the compressed data
+    constexpr uint64_t DECODED_TEXTURE_FACTOR = 6;
+
+    uint64_t bytes = BASE_BYTES + contents.m_FileBytes * 2 + contents.m_ModelBytes * 2;
+    if (options.textures.bTextures)
+    {
+        bytes += contents.m_TextureBytes * DECODED_TEXTURE_FACTOR;
+    }
+    if (options.bake.bEnabled)
+    {
+        // every tile gets rendered and encoded
+        const uint64_t tileBytes = (uint64_t)options.bake.tileResolution * options.bake.tileResolution * 4;
+        bytes += (uint64_t)options.bake.tilesPerSide * options.bake.tilesPerSide * tileBytes * 2;
+    }
+    return bytes;
+}
+
+
+BatchScheduler::BatchScheduler(uint64_t limitBytes) :
+    m_LimitBytes(limitBytes),
+    m_BaseBytes(getResidentMemory())
+{
+
+}
+
+void BatchScheduler::Add(uint32_t job, uint64_t estimatedBytes)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_LimitBytes == 0)
+    {
+        m_Pending.push_back({ job, estimatedBytes });
+        return;
+    }
+
+    // largest first, equal ones in the order they were added
+    auto pos = std::upper_bound(m_Pending.begin(), m_Pending.end(), estimatedBytes, [](uint64_t bytes, const Job& pending)
+    {
+        return bytes > pending.m_EstimatedBytes;
+    });
+    m_Pending.insert(pos, { job, estimatedBytes });
+}
+
+bool BatchScheduler::Next(uint32_t& outJob)
+{
+    // resident memory gets checked again every so often, since it also drops while jobs are running
+    constexpr auto RECHECK_INTERVAL = std::chrono::milliseconds(250);
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (!m_Pending.empty())
+    {
+        auto next = m_Pending.begin();
+        if (m_LimitBytes > 0 && !m_Running.empty())
+        {
+            const uint64_t inUse = std::max(m_BaseBytes + m_RunningBytes, getResidentMemory());
+            next = std::find_if(m_Pending.begin(), m_Pending.end(), [&](const Job& job)
+            {
+                return inUse + job.m_EstimatedBytes <= m_LimitBytes;
+            });
+        }
+        if (next == m_Pending.end())
+        {
+            m_JobDone.wait_for(lock, RECHECK_INTERVAL);
+            continue;
+        }
+
+        outJob = next->m_Job;
+        m_RunningBytes += next->m_EstimatedBytes;
+        m_Running.push_back(*next);
+        m_Pending.erase(next);
+        return true;
+    }
+    return false;
+}
+
+void BatchScheduler::Done(uint32_t job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto it = std::find_if(m_Running.begin(), m_Running.end(), [job](const Job& running) { return running.m_Job == job; });
+        if (it != m_Running.end())
+        {
+            m_RunningBytes -= it->m_EstimatedBytes;
+            m_Running.erase(it);
+        }
+    }
+    m_JobDone.notify_all();
+}
+
+bool BatchScheduler::GetPending(size_t ahead, uint32_t& outJob) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (ahead >= m_Pending.size())
+    {
+        return false;
+    }
+    outJob = m_Pending[ahead].m_Job;
+    return true;
+}
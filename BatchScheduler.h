@@ -0,0 +1,49 @@
+#pragma once
+#include "LVLScanner.h"
+#include "WorldConverter.h"
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Rough peak memory of converting a single LVL, from the chunk sizes of its scan: LibSWBF2 holds the whole
+// file plus what it parsed out of it, textures get decoded to RGBA with all their mip levels (several times
+// their compressed size) and the converted models and encoded images pile up for the output.
+uint64_t estimateJobMemory(const LVLContents& contents, const ConvertOptions& options);
+
+// Hands out the LVLs of a batch to the converting threads, so the memory of all running jobs stays below a limit.
+// The largest jobs go first, and whenever the next one doesn't fit, smaller ones get packed into what's left.
+// Estimates alone may be off, so jobs also have to fit next to the resident memory actually in use.
+// A job larger than the limit on its own still runs, once nothing else does.
+class BatchScheduler
+{
+public:
+    // 'limitBytes' 0 for no limit, jobs get handed out in the order they were added then
+    BatchScheduler(uint64_t limitBytes);
+
+    void Add(uint32_t job, uint64_t estimatedBytes);
+
+    // Blocks until the next job fits. Returns false once every job got handed out.
+    bool Next(uint32_t& outJob);
+    void Done(uint32_t job);
+
+    // The job 'ahead' places down the queue, to read ahead. False if there are not that many left.
+    bool GetPending(size_t ahead, uint32_t& outJob) const;
+
+private:
+    struct Job
+    {
+        uint32_t m_Job = 0;
+        uint64_t m_EstimatedBytes = 0;
+    };
+
+    uint64_t m_LimitBytes;
+
+    // whatever was resident before the first job, e.g. the common LVLs
+    uint64_t m_BaseBytes = 0;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_JobDone;
+    std::vector<Job> m_Pending;
+    std::vector<Job> m_Running;
+    uint64_t m_RunningBytes = 0;
+};
@@ -0,0 +1,312 @@
+#include "BinaryWriter.h"
+#include "Platform.h"
+#include <filesystem>
+#include <sstream>
+#include <json.hpp>
+
+namespace fs = std::filesystem;
+
+constexpr uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+constexpr uint32_t GLB_VERSION = 2;
+constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;  // "BIN\0"
+
+
+// all images are part of buffer 0 already, nothing left to do for tinygltf
+static bool skipImageData(const std::string* basePath, const std::string* fileName, tinygltf::Image* image, bool bEmbedImages, void* userData)
+{
+    return true;
+}
+
+
+BinaryWriter::BinaryWriter(tinygltf::Model& gltf, const std::string& spillFile, uint64_t maxQueuedBytes, uint64_t maxMemoryBytes) :
+    m_Gltf(gltf),
+    m_MaxMemoryBytes(maxMemoryBytes),
+    m_SpillTarget(spillFile),
+    m_MaxQueuedBytes(maxQueuedBytes)
+{
+    if (!m_SpillTarget.empty() && m_MaxMemoryBytes == 0)
+    {
+        StartSpilling();
+    }
+}
+
+BinaryWriter::~BinaryWriter()
+{
+    StopWriter();
+    if (IsSpilling())
+    {
+        m_SpillFile.close();
+        std::error_code err;
+        fs::remove(m_SpillPath, err);
+    }
+}
+
+bool BinaryWriter::IsSpilling() const
+{
+    return !m_SpillPath.empty();
+}
+
+int BinaryWriter::AddBufferView(std::vector<uint8_t>&& data, size_t byteStride)
+{
+    // keep every view 4 byte aligned, as required for float data
+    const size_t byteLength = data.size();
+    data.resize((byteLength + 3) & ~(size_t)3, 0);
+
+    tinygltf::BufferView& view = m_Gltf.bufferViews.emplace_back();
+    view.buffer = 0;
+    view.byteOffset = (size_t)m_Size;
+    view.byteLength = byteLength;
+    view.byteStride = byteStride;
+    m_Size += data.size();
+
+    if (!IsSpilling())
+    {
+        if (m_Gltf.buffers.empty())
+        {
+            m_Gltf.buffers.emplace_back();
+        }
+        std::vector<unsigned char>& buffer = m_Gltf.buffers[0].data;
+        buffer.insert(buffer.end(), data.begin(), data.end());
+
+        if (!m_SpillTarget.empty() && m_Size > m_MaxMemoryBytes)
+        {
+            StartSpilling();
+        }
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        // wait for the I/O thread to catch up. A single block larger than the limit still has to go through
+        m_BlockWritten.wait(lock, [this, &data]()
+        {
+            return m_QueuedBytes == 0 || m_QueuedBytes + data.size() <= m_MaxQueuedBytes;
+        });
+        m_QueuedBytes += data.size();
+        m_Queue.emplace_back(std::move(data));
+        lock.unlock();
+        m_BlockQueued.notify_one();
+    }
+
+    return (int)m_Gltf.bufferViews.size() - 1;
+}
+
+bool BinaryWriter::Write(const std::string& fileOut, bool bBinary)
+{
+    if (IsSpilling())
+    {
+        return bBinary ? AssembleGlb(fileOut) : AssembleGltf(fileOut);
+    }
+
+    tinygltf::TinyGLTF writer;
+    writer.SetImageWriter(&skipImageData, nullptr);
+    return writer.WriteGltfSceneToFile(&m_Gltf, fileOut, false, true, true, bBinary);
+}
+
+bool BinaryWriter::Write(const OutputWriter& write, const std::string& name)
+{
+    return WriteGlb(write, name);
+}
+
+void BinaryWriter::StartSpilling()
+{
+    m_SpillFile.open(m_SpillTarget, std::ios::binary | std::ios::trunc);
+    if (!m_SpillFile)
+    {
+        LOG("Could not create spill file '{0}'! Keeping everything in memory.", m_SpillTarget.c_str());
+        m_SpillTarget.clear();
+        return;
+    }
+    m_SpillPath = m_SpillTarget;
+
+    // whatever piled up in memory so far goes first
+    if (!m_Gltf.buffers.empty() && !m_Gltf.buffers[0].data.empty())
+    {
+        m_QueuedBytes = m_Gltf.buffers[0].data.size();
+        m_Queue.emplace_back(std::move(m_Gltf.buffers[0].data));
+        m_Gltf.buffers[0].data = std::vector<unsigned char>();
+    }
+    m_WriterThread = std::thread(&BinaryWriter::WriterLoop, this);
+}
+
+void BinaryWriter::WriterLoop()
+{
+    while (true)
+    {
+        std::vector<uint8_t> block;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_BlockQueued.wait(lock, [this]() { return m_bStop || !m_Queue.empty(); });
+            if (m_Queue.empty())
+            {
+                // stopped and drained
+                return;
+            }
+            block = std::move(m_Queue.front());
+            m_Queue.pop_front();
+        }
+
+        if (!m_bFailed && !m_SpillFile.write(reinterpret_cast<const char*>(block.data()), block.size()))
+        {
+            LOG("Writing to spill file '{0}' failed!", m_SpillPath.c_str());
+            m_bFailed = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_QueuedBytes -= block.size();
+        }
+        m_BlockWritten.notify_all();
+    }
+}
+
+void BinaryWriter::StopWriter()
+{
+    if (!m_WriterThread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bStop = true;
+    }
+    m_BlockQueued.notify_one();
+    m_WriterThread.join();
+}
+
+bool BinaryWriter::SerializeJson(const std::string& bufferUri, bool bPrettyPrint, std::string& outJson)
+{
+    // let tinygltf serialize everything but the binary buffer, which already is on disk
+    std::vector<tinygltf::Buffer> buffers = std::move(m_Gltf.buffers);
+    m_Gltf.buffers.clear();
+
+    tinygltf::TinyGLTF writer;
+    writer.SetImageWriter(&skipImageData, nullptr);
+    std::ostringstream jsonStream;
+    bool bSerialized = writer.WriteGltfSceneToStream(&m_Gltf, jsonStream, false, false);
+    m_Gltf.buffers = std::move(buffers);
+    if (!bSerialized)
+    {
+        return false;
+    }
+
+    nlohmann::json json = nlohmann::json::parse(jsonStream.str());
+    if (m_Size > 0)
+    {
+        nlohmann::json buffer = { { "byteLength", m_Size } };
+        if (!bufferUri.empty())
+        {
+            buffer["uri"] = bufferUri;
+        }
+        json["buffers"] = nlohmann::json::array({ buffer });
+    }
+    outJson = bPrettyPrint ? json.dump(2) : json.dump();
+    return true;
+}
+
+bool BinaryWriter::AssembleGlb(const std::string& fileOut)
+{
+    // only created once there is something to write, a failure before leaves any previous file alone
+    std::ofstream file;
+    auto write = [&file, &fileOut](const uint8_t* data, size_t size)
+    {
+        if (!file.is_open())
+        {
+            file.open(fileOut, std::ios::binary | std::ios::trunc);
+        }
+        return (bool)file.write(reinterpret_cast<const char*>(data), (std::streamsize)size);
+    };
+    return WriteGlb(write, fileOut);
+}
+
+bool BinaryWriter::WriteGlb(const OutputWriter& write, const std::string& name)
+{
+    StopWriter();
+    m_SpillFile.close();
+    if (m_bFailed)
+    {
+        return false;
+    }
+
+    std::string jsonChunk;
+    if (!SerializeJson("", false, jsonChunk))
+    {
+        return false;
+    }
+    jsonChunk.resize((jsonChunk.size() + 3) & ~(size_t)3, ' ');
+
+    const uint64_t binChunkSize = m_Size > 0 ? 8 + m_Size : 0;
+    const uint64_t totalSize = 12 + 8 + jsonChunk.size() + binChunkSize;
+    if (totalSize > UINT32_MAX)
+    {
+        LOG("'{0}' would exceed the maximum .glb size of 4 GB!", name.c_str());
+        return false;
+    }
+
+    // only mapped now, so the spilled data doesn't count against the memory during conversion
+    MappedFile spill;
+    const uint8_t* binData = nullptr;
+    if (m_Size > 0 && IsSpilling())
+    {
+        if (!spill.Open(m_SpillPath) || spill.GetSize() < m_Size)
+        {
+            LOG("Reading back the spill file '{0}' failed!", m_SpillPath.c_str());
+            return false;
+        }
+        binData = spill.GetData();
+    }
+    else if (m_Size > 0)
+    {
+        binData = m_Gltf.buffers[0].data.data();
+    }
+
+    // GLB is little endian, as is every platform we build for
+    const uint32_t header[] = { GLB_MAGIC, GLB_VERSION, (uint32_t)totalSize, (uint32_t)jsonChunk.size(), GLB_CHUNK_JSON };
+    const uint32_t binHeader[] = { (uint32_t)m_Size, GLB_CHUNK_BIN };
+    bool bWritten = write(reinterpret_cast<const uint8_t*>(header), sizeof(header));
+    bWritten = bWritten && write(reinterpret_cast<const uint8_t*>(jsonChunk.data()), jsonChunk.size());
+    if (m_Size > 0)
+    {
+        bWritten = bWritten && write(reinterpret_cast<const uint8_t*>(binHeader), sizeof(binHeader));
+        bWritten = bWritten && write(binData, (size_t)m_Size);
+    }
+
+    if (!bWritten)
+    {
+        LOG("Writing the binary data into '{0}' failed!", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool BinaryWriter::AssembleGltf(const std::string& fileOut)
+{
+    StopWriter();
+    m_SpillFile.close();
+    if (m_bFailed)
+    {
+        return false;
+    }
+
+    // the spill file already is exactly what an external buffer file has to contain
+    fs::path binPath = fileOut;
+    binPath.replace_extension(".bin");
+    std::error_code err;
+    fs::rename(m_SpillPath, binPath, err);
+    if (err)
+    {
+        LOG("Could not move the spill file to '{0}': {1}", binPath.u8string().c_str(), err.message().c_str());
+        return false;
+    }
+
+    std::string json;
+    if (!SerializeJson(binPath.filename().u8string(), true, json))
+    {
+        return false;
+    }
+    std::ofstream file(fileOut, std::ios::trunc);
+    file << json;
+    return (bool)file;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "Common.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Receives an output file in consecutive pieces. Returns false to stop writing.
+using OutputWriter = std::function<bool(const uint8_t* data, size_t size)>;
+
+// Collects the binary payload of a glTF model (vertex and index data, encoded images) as buffer views of buffer 0.
+// Without a spill file, everything piles up in memory in buffer 0, for tinygltf to write at the end.
+// With a spill file, buffer 0 stays in memory only up to 'maxMemoryBytes'. From then on, it moves into the
+// spill file and every finished block is handed to a dedicated I/O thread right away, so writing to disk
+// overlaps with the conversion. Producers block while more than 'maxQueuedBytes' wait to be written.
+// The output then gets assembled from the JSON and the spill file in Write(): a .glb gets the spill file
+// mapped back in as its BIN chunk, while a .gltf references it as external .bin file.
+class BinaryWriter
+{
+public:
+    BinaryWriter(tinygltf::Model& gltf, const std::string& spillFile = "", uint64_t maxQueuedBytes = 64 * 1024 * 1024, uint64_t maxMemoryBytes = 0);
+    ~BinaryWriter();
+
+    BinaryWriter(const BinaryWriter&) = delete;
+    BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+    // Appends 'data' to buffer 0 and returns the index of the new buffer view.
+    // Must always be called from the same thread.
+    int AddBufferView(std::vector<uint8_t>&& data, size_t byteStride);
+
+    // Writes the output file, .glb if 'bBinary' is set, .gltf otherwise
+    bool Write(const std::string& fileOut, bool bBinary);
+
+    // Hands a .glb to 'write' instead of writing it to a file. 'name' is only for the log.
+    bool Write(const OutputWriter& write, const std::string& name);
+
+    bool IsSpilling() const;
+
+private:
+    void StartSpilling();
+    void WriterLoop();
+    void StopWriter();
+    bool SerializeJson(const std::string& bufferUri, bool bPrettyPrint, std::string& outJson);
+    bool AssembleGlb(const std::string& fileOut);
+    bool WriteGlb(const OutputWriter& write, const std::string& name);
+    bool AssembleGltf(const std::string& fileOut);
+
+    tinygltf::Model& m_Gltf;
+    uint64_t m_Size = 0;
+    uint64_t m_MaxMemoryBytes = 0;
+
+    // where to spill to, once 'm_MaxMemoryBytes' is exceeded. 'm_SpillPath' is only set while spilling
+    std::string m_SpillTarget;
+    std::string m_SpillPath;
+    std::ofstream m_SpillFile;
+    std::thread m_WriterThread;
+    std::mutex m_Mutex;
+    std::condition_variable m_BlockQueued;
+    std::condition_variable m_BlockWritten;
+    std::deque<std::vector<uint8_t>> m_Queue;
+    uint64_t m_QueuedBytes = 0;
+    uint64_t m_MaxQueuedBytes = 0;
+    bool m_bStop = false;
+    std::atomic<bool> m_bFailed = false;
+};
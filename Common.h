@@ -0,0 +1,33 @@
+#pragma once
+#include <iostream>
+#include <fmt/format.h>
+#include <fmt/printf.h>
+#include <LibSWBF2.h>
+#include <tiny_gltf.h>
+
+#define LOG(formatStr, ...) std::cout << fmt::format(formatStr, __VA_ARGS__) << std::endl;
+
+// Prints all pending log messages of LibSWBF2. Returns false if there were none.
+bool grabLibSWBF2Logs();
+
+using LibSWBF2::Logging::Logger;
+using LibSWBF2::Logging::LoggerEntry;
+using LibSWBF2::ELogType;
+using LibSWBF2::Level;
+using LibSWBF2::Container;
+using LibSWBF2::SWBF2Handle;
+using LibSWBF2::ETopology;
+using LibSWBF2::ETextureFormat;
+using LibSWBF2::Types::List;
+using LibSWBF2::Types::Vector2;
+using LibSWBF2::Types::Vector3;
+using LibSWBF2::Types::Vector4;
+using LibSWBF2::Types::String;
+using LibSWBF2::Types::Color4u8;
+using LibSWBF2::Wrappers::World;
+using LibSWBF2::Wrappers::Terrain;
+using LibSWBF2::Wrappers::Instance;
+using LibSWBF2::Wrappers::Model;
+using LibSWBF2::Wrappers::Segment;
+using LibSWBF2::Wrappers::Material;
+using LibSWBF2::Wrappers::Texture;
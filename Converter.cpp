@@ -0,0 +1,100 @@
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "Converter.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+// what the logs call the output, it never gets written under this name
+static const std::string OUTPUT_NAME = "in-memory.glb";
+
+
+LVLConverter::LVLConverter(const ConvertOptions& options, uint32_t numThreads) :
+    m_Options(options),
+    m_Pool(numThreads)
+{
+
+}
+
+void LVLConverter::SetCommon(const Container* common, const std::string& commonLVL)
+{
+    m_Common = common;
+    m_CommonContents = LVLContents();
+    m_bCommonScanned = common != nullptr && !commonLVL.empty() && scanLVL(commonLVL, m_CommonContents);
+}
+
+ConvertOptions LVLConverter::GetOptions(const OutputWriter& write) const
+{
+    ConvertOptions options = m_Options;
+    options.bGLTF = false;
+    options.bSplitLayers = false;
+    options.journal = nullptr;
+    options.writeOutput = [&write](const std::string& file, const uint8_t* data, size_t size)
+    {
+        return write(data, size);
+    };
+    return options;
+}
+
+bool LVLConverter::Convert(const Level* world, const LayerFilter& isChosen, const OutputWriter& write)
+{
+    if (world == nullptr)
+    {
+        return false;
+    }
+
+    SourceScene scene(world, m_Common);
+    std::vector<bool> chosenLayers;
+    for (const SourceLayer& layer : scene.GetLayers())
+    {
+        chosenLayers.push_back(!isChosen || isChosen(layer.m_Name));
+    }
+    return convertWorld(scene, nullptr, chosenLayers, GetOptions(write), m_Pool, OUTPUT_NAME);
+}
+
+bool LVLConverter::Convert(const Level* world, const LayerFilter& isChosen, std::vector<uint8_t>& outGlb)
+{
+    outGlb.clear();
+    auto write = [&outGlb](const uint8_t* data, size_t size)
+    {
+        outGlb.insert(outGlb.end(), data, data + size);
+        return true;
+    };
+    return Convert(world, isChosen, write);
+}
+
+bool LVLConverter::Convert(const uint8_t* lvlData, size_t lvlSize, const LayerFilter& isChosen, const OutputWriter& write)
+{
+    std::error_code err;
+    const fs::path tempDir = fs::temp_directory_path(err) / "LVL2glTF";
+    fs::create_directories(tempDir, err);
+    const std::string tempFile = (tempDir / fmt::format("{0:08x}.lvl", std::random_device()())).u8string();
+    {
+        std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(lvlData), (std::streamsize)lvlSize))
+        {
+            LOG("Could not write the LVL to '{0}'!", tempFile.c_str());
+            fs::remove(tempFile, err);
+            return false;
+        }
+    }
+
+    const LVLContents* commonContents = m_bCommonScanned ? &m_CommonContents : nullptr;
+    bool bSuccess = convertStandalone(tempFile, m_Common, commonContents, isChosen, GetOptions(write), m_Pool, OUTPUT_NAME);
+    fs::remove(tempFile, err);
+    return bSuccess;
+}
+
+bool LVLConverter::Convert(const uint8_t* lvlData, size_t lvlSize, const LayerFilter& isChosen, std::vector<uint8_t>& outGlb)
+{
+    outGlb.clear();
+    auto write = [&outGlb](const uint8_t* data, size_t size)
+    {
+        outGlb.insert(outGlb.end(), data, data + size);
+        return true;
+    };
+    return Convert(lvlData, lvlSize, isChosen, write);
+}
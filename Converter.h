@@ -0,0 +1,42 @@
+#pragma once
+#include "BinaryWriter.h"
+#include "WorldConverter.h"
+#include <string>
+#include <vector>
+
+// Entry point for embedding the conversion into other programs, e.g. an asset server, without starting
+// LVL2glTF and reading its output back from disk. Built as the LVL2glTFLib static library, which the
+// command line tool links as well. Every conversion produces a single .glb in memory, so 'bGLTF',
+// 'bSplitLayers' and the journal of the options are ignored. Converting into a vector reuses its capacity,
+// so a caller converting into the same buffer over and over rarely allocates. Conversions may run concurrently.
+class LVLConverter
+{
+public:
+    // 'numThreads' 0 for one per hardware thread. All conversions share these threads.
+    LVLConverter(const ConvertOptions& options, uint32_t numThreads = 0);
+
+    // Assets missing in the world LVLs get looked up in 'common', which has to stay loaded for as long as
+    // conversions run. 'commonLVL' is the file loaded into it (e.g. ingame.lvl), if known. It gets scanned
+    // to load world LVL buffers selectively. Must not be called while converting.
+    void SetCommon(const Container* common, const std::string& commonLVL);
+
+    // Converts the chosen layers (all, without 'isChosen') of a world LVL the caller loaded
+    // and keeps loaded during the call
+    bool Convert(const Level* world, const LayerFilter& isChosen, const OutputWriter& write);
+    bool Convert(const Level* world, const LayerFilter& isChosen, std::vector<uint8_t>& outGlb);
+
+    // Converts the chosen layers of a world LVL file's content, loading only what they need. LibSWBF2 only
+    // loads from files, so the content passes through the temp directory. With a parse cache in the options,
+    // content converted before doesn't get loaded at all. No layer being chosen is no error, there just is no output then.
+    bool Convert(const uint8_t* lvlData, size_t lvlSize, const LayerFilter& isChosen, const OutputWriter& write);
+    bool Convert(const uint8_t* lvlData, size_t lvlSize, const LayerFilter& isChosen, std::vector<uint8_t>& outGlb);
+
+private:
+    ConvertOptions GetOptions(const OutputWriter& write) const;
+
+    ConvertOptions m_Options;
+    TaskPool m_Pool;
+    const Container* m_Common = nullptr;
+    LVLContents m_CommonContents;
+    bool m_bCommonScanned = false;
+};
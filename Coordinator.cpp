@@ -0,0 +1,310 @@
+#include "Coordinator.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <json.hpp>
+
+namespace fs = std::filesystem;
+using Json = nlohmann::json;
+
+
+BatchCoordinator::BatchCoordinator(const std::vector<std::string>& workerArgs, uint32_t numWorkers, const std::atomic<bool>* cancelled) :
+    m_Executable(getExecutablePath()),
+    m_WorkerArgs(workerArgs),
+    m_NumWorkers(std::max(numWorkers, 1u)),
+    m_Cancelled(cancelled)
+{
+
+}
+
+uint32_t BatchCoordinator::Run(const std::vector<std::string>& filesIn, const std::vector<std::string>& filesOut)
+{
+    if (m_Executable.empty())
+    {
+        LOG("Could not determine the path of the executable to start the workers with!");
+        return (uint32_t)filesIn.size();
+    }
+
+    std::error_code err;
+    const fs::path workDir = fs::temp_directory_path(err) / "LVL2glTF" / "workers";
+    fs::create_directories(workDir, err);
+    if (err)
+    {
+        LOG("Could not create '{0}': {1}", workDir.u8string().c_str(), err.message().c_str());
+        return (uint32_t)filesIn.size();
+    }
+
+    // the largest LVLs go first, so no worker is left with a big one while the others are already done
+    m_FilesIn = &filesIn;
+    m_FilesOut = &filesOut;
+    m_Order.clear();
+    std::vector<uintmax_t> sizes;
+    for (uint32_t idx = 0; idx < filesIn.size(); ++idx)
+    {
+        m_Order.push_back(idx);
+        uintmax_t size = fs::file_size(filesIn[idx], err);
+        sizes.push_back(err ? 0 : size);
+    }
+    std::stable_sort(m_Order.begin(), m_Order.end(), [&sizes](uint32_t a, uint32_t b) { return sizes[a] > sizes[b]; });
+    m_NextJob = 0;
+    m_GivenBack.clear();
+    m_NumStarting = 0;
+    m_NumFinished = 0;
+
+    // several coordinators may run at the same time
+    const std::string runId = fmt::format("{0:08x}", std::random_device()());
+    std::vector<Worker> workers(std::min(m_NumWorkers, (uint32_t)filesIn.size()));
+    for (uint32_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].m_Index = i;
+        workers[i].m_SocketPath = (workDir / fmt::format("{0}-{1}.sock", runId, i)).u8string();
+        workers[i].m_LogPath = (workDir / fmt::format("{0}-{1}.log", runId, i)).u8string();
+    }
+
+    LOG("Converting {0} LVLs with {1} worker processes...", filesIn.size(), workers.size());
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (Worker& worker : workers)
+    {
+        threads.emplace_back(&BatchCoordinator::RunWorker, this, std::ref(worker));
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // only left if no worker could be started at all, or on Ctrl+C
+    for (uint32_t job : m_GivenBack)
+    {
+        LOG("'{0}' {1}", filesIn[job].c_str(), m_Cancelled != nullptr && *m_Cancelled ? "cancelled" : "failed, no worker could be started to convert it!");
+    }
+
+    uint32_t numFailed = (uint32_t)filesIn.size();
+    uint64_t outputBytes = 0;
+    for (const Worker& worker : workers)
+    {
+        numFailed -= worker.m_NumJobs - worker.m_NumFailed;
+        outputBytes += worker.m_OutputBytes;
+        LOG("Worker {0}: {1} LVLs, {2} failed, {3} crashes, {4} MB written, peak memory {5} MB",
+            worker.m_Index, worker.m_NumJobs, worker.m_NumFailed, worker.m_NumCrashes,
+            worker.m_OutputBytes / (1024 * 1024), worker.m_PeakMemory / (1024 * 1024));
+
+        // only logs telling what went wrong are worth keeping
+        if (worker.m_NumFailed > 0)
+        {
+            LOG("    See '{0}' for its log.", worker.m_LogPath.c_str());
+        }
+        else
+        {
+            fs::remove(worker.m_LogPath, err);
+        }
+    }
+    LOG("Converted {0} of {1} LVLs in {2:.2f}s, {3} MB written.", filesIn.size() - numFailed, filesIn.size(), seconds, outputBytes / (1024 * 1024));
+    return numFailed;
+}
+
+bool BatchCoordinator::StartWorker(Worker& worker)
+{
+    std::vector<std::string> args = m_WorkerArgs;
+    args.push_back("--daemon");
+    args.push_back(worker.m_SocketPath);
+
+    std::error_code err;
+    fs::remove(worker.m_SocketPath, err);
+    if (!worker.m_Process.Start(m_Executable, args, worker.m_LogPath))
+    {
+        LOG("Could not start worker {0}!", worker.m_Index);
+        return false;
+    }
+
+    // the socket only shows up once the worker loaded the common LVLs
+    while (!worker.m_Socket.Connect(worker.m_SocketPath))
+    {
+        if (!worker.m_Process.IsRunning())
+        {
+            LOG("Worker {0} exited before accepting jobs, see '{1}'!", worker.m_Index, worker.m_LogPath.c_str());
+            return false;
+        }
+        if (m_Cancelled != nullptr && *m_Cancelled)
+        {
+            worker.m_Process.Kill();
+            worker.m_Process.Wait();
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return true;
+}
+
+void BatchCoordinator::StopWorker(Worker& worker)
+{
+    // wait for the daemon to close the connection, so it's really done
+    std::string line;
+    if (worker.m_Socket.WriteLine(Json({ { "command", "shutdown" } }).dump()))
+    {
+        while (worker.m_Socket.ReadLine(line))
+        {
+
+        }
+    }
+    worker.m_Socket.Close();
+    worker.m_Process.Wait();
+
+    std::error_code err;
+    fs::remove(worker.m_SocketPath, err);
+}
+
+bool BatchCoordinator::TakeJob(bool bStarting, uint32_t& outJob)
+{
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_JobsMutex);
+            const bool bGivenBack = !m_GivenBack.empty();
+            if (bGivenBack || m_NextJob < m_Order.size())
+            {
+                if (bGivenBack)
+                {
+                    outJob = m_GivenBack.back();
+                    m_GivenBack.pop_back();
+                }
+                else
+                {
+                    outJob = m_Order[m_NextJob++];
+                }
+                m_NumStarting += bStarting ? 1 : 0;
+                return true;
+            }
+            if (m_NumStarting == 0)
+            {
+                return false;
+            }
+        }
+
+        // a worker still starting might give its job back
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+void BatchCoordinator::GiveBack(uint32_t job)
+{
+    std::lock_guard<std::mutex> lock(m_JobsMutex);
+    m_GivenBack.push_back(job);
+}
+
+void BatchCoordinator::RunWorker(Worker& worker)
+{
+    bool bRunning = false;
+    uint32_t job;
+    while (TakeJob(!bRunning, job))
+    {
+        if (m_Cancelled != nullptr && *m_Cancelled)
+        {
+            worker.m_NumJobs++;
+            worker.m_NumFailed++;
+            if (!bRunning)
+            {
+                std::lock_guard<std::mutex> lock(m_JobsMutex);
+                m_NumStarting--;
+            }
+            continue;
+        }
+
+        if (!bRunning)
+        {
+            bRunning = StartWorker(worker);
+            if (!bRunning)
+            {
+                // nothing this worker could do, so the others get its job and the rest
+                GiveBack(job);
+            }
+            std::lock_guard<std::mutex> lock(m_JobsMutex);
+            m_NumStarting--;
+        }
+        if (!bRunning)
+        {
+            break;
+        }
+
+        bool bCrashed = false;
+        worker.m_NumJobs++;
+        if (!Convert(worker, job, bCrashed))
+        {
+            worker.m_NumFailed++;
+        }
+        if (bCrashed)
+        {
+            // on Ctrl+C, the workers get the signal as well
+            if (m_Cancelled != nullptr && *m_Cancelled)
+            {
+                break;
+            }
+
+            // the next job gets a fresh worker
+            worker.m_NumCrashes++;
+            worker.m_Socket.Close();
+            worker.m_Process.Kill();
+            worker.m_Process.Wait();
+            bRunning = false;
+        }
+    }
+
+    if (bRunning)
+    {
+        StopWorker(worker);
+    }
+}
+
+bool BatchCoordinator::Convert(Worker& worker, uint32_t job, bool& outCrashed)
+{
+    const std::string& fileIn = (*m_FilesIn)[job];
+    const Json request = { { "id", job }, { "input", fileIn }, { "output", (*m_FilesOut)[job] } };
+
+    bool bSuccess = false;
+    double seconds = 0.0;
+    std::string line;
+    outCrashed = !worker.m_Socket.WriteLine(request.dump());
+    while (!outCrashed)
+    {
+        if (!worker.m_Socket.ReadLine(line))
+        {
+            outCrashed = true;
+            break;
+        }
+
+        Json message = Json::parse(line, nullptr, false);
+        const std::string event = message.is_object() ? message.value("event", "") : "";
+        if (event != "done" && event != "error")
+        {
+            continue;
+        }
+
+        bSuccess = event == "done";
+        seconds = message.value("seconds", 0.0);
+        worker.m_PeakMemory = std::max(worker.m_PeakMemory, message.value("peakMemory", (uint64_t)0));
+        for (const Json& output : message.value("outputs", Json::array()))
+        {
+            worker.m_OutputBytes += output.value("bytes", (uint64_t)0);
+        }
+        break;
+    }
+
+    const uint32_t numFinished = ++m_NumFinished;
+    std::lock_guard<std::mutex> lock(m_LogMutex);
+    if (outCrashed && m_Cancelled != nullptr && *m_Cancelled)
+    {
+        LOG("[{0}/{1}] '{2}' cancelled", numFinished, m_Order.size(), fileIn.c_str());
+    }
+    else if (outCrashed)
+    {
+        LOG("[{0}/{1}] '{2}' crashed worker {3}, see '{4}'!", numFinished, m_Order.size(), fileIn.c_str(), worker.m_Index, worker.m_LogPath.c_str());
+    }
+    else
+    {
+        LOG("[{0}/{1}] '{2}' {3} after {4:.2f}s on worker {5}", numFinished, m_Order.size(), fileIn.c_str(), bSuccess ? "done" : "failed", seconds, worker.m_Index);
+    }
+    return bSuccess;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "Common.h"
+#include "Platform.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Converts a batch of world LVLs with several worker processes instead of threads, each being this very
+// executable running as a daemon (see Daemon.h) with the batch's conversion options and its own copy of the
+// common LVLs. Every worker pulls the next LVL as soon as it's done with the last one, largest LVLs first,
+// so workers finishing early take over what's left instead of idling. A worker that crashes (e.g. in LibSWBF2
+// on a malformed map) only fails the LVL it was converting, and gets started again for the remaining ones.
+class BatchCoordinator
+{
+public:
+    // 'workerArgs' are the command line options every worker gets, besides --daemon
+    BatchCoordinator(const std::vector<std::string>& workerArgs, uint32_t numWorkers, const std::atomic<bool>* cancelled);
+
+    // Converts 'filesIn[i]' into 'filesOut[i]'. Returns the number of LVLs that failed.
+    uint32_t Run(const std::vector<std::string>& filesIn, const std::vector<std::string>& filesOut);
+
+private:
+    struct Worker
+    {
+        uint32_t m_Index = 0;
+        std::string m_SocketPath;
+        std::string m_LogPath;
+        ChildProcess m_Process;
+        LocalSocket m_Socket;
+
+        uint32_t m_NumJobs = 0;
+        uint32_t m_NumFailed = 0;
+        uint32_t m_NumCrashes = 0;
+        uint64_t m_OutputBytes = 0;
+        uint64_t m_PeakMemory = 0;
+    };
+
+    bool StartWorker(Worker& worker);
+    void StopWorker(Worker& worker);
+    void RunWorker(Worker& worker);
+
+    // Hands out jobs given back first. False once there are no jobs left, which a worker that isn't
+    // running yet might still give back. 'bStarting' if the caller has to start its worker for the job.
+    bool TakeJob(bool bStarting, uint32_t& outJob);
+
+    // Gives back the job of a worker that could not be started, so the others convert it
+    void GiveBack(uint32_t job);
+
+    // False if the job failed. Sets 'outCrashed' if the worker went away meanwhile.
+    bool Convert(Worker& worker, uint32_t job, bool& outCrashed);
+
+    std::string m_Executable;
+    std::vector<std::string> m_WorkerArgs;
+    uint32_t m_NumWorkers;
+    const std::atomic<bool>* m_Cancelled;
+
+    const std::vector<std::string>* m_FilesIn = nullptr;
+    const std::vector<std::string>* m_FilesOut = nullptr;
+
+    // indices into the files, in the order they get handed out
+    std::vector<uint32_t> m_Order;
+    std::mutex m_JobsMutex;
+    uint32_t m_NextJob = 0;
+    std::vector<uint32_t> m_GivenBack;
+    uint32_t m_NumStarting = 0;
+    std::atomic<uint32_t> m_NumFinished = 0;
+
+    // progress of all workers goes into a single log
+    std::mutex m_LogMutex;
+};
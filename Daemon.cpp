@@ -0,0 +1,230 @@
+#include "Daemon.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include <json.hpp>
+
+namespace fs = std::filesystem;
+using Json = nlohmann::json;
+
+
+ConversionDaemon::ConversionDaemon(
+    const Container* common,
+    const LVLContents* commonContents,
+    const ConvertOptions& defaults,
+    const LayerFilter& defaultFilter,
+    TaskPool& pool
+) :
+    m_Common(common),
+    m_CommonContents(commonContents),
+    m_Defaults(defaults),
+    m_DefaultFilter(defaultFilter),
+    m_Pool(pool)
+{
+
+}
+
+ConversionDaemon::~ConversionDaemon()
+{
+    Stop();
+}
+
+bool ConversionDaemon::Run(const std::string& socketPath)
+{
+    if (!m_Server.Listen(socketPath))
+    {
+        LOG("Could not listen on '{0}'! It must not be an existing file or the socket of a daemon still running.", socketPath.c_str());
+        return false;
+    }
+    LOG("Waiting for jobs on '{0}'...", socketPath.c_str());
+
+    while (!m_bStop)
+    {
+        // on Ctrl+C, running jobs get cancelled through the options and the daemon stops
+        if (m_Defaults.cancelled != nullptr && *m_Defaults.cancelled)
+        {
+            LOG("Cancelled, stopping...");
+            Stop();
+            break;
+        }
+
+        // Stop() can't wake up a waiting Accept() on every platform, so it only waits for a moment at a time
+        auto client = std::make_unique<LocalSocket>();
+        bool bTimedOut = false;
+        if (!m_Server.Accept(*client, 200, bTimedOut))
+        {
+            if (!m_bStop && !bTimedOut)
+            {
+                LOG("Accepting a connection failed!");
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(m_ClientsMutex);
+        LocalSocket* raw = client.release();
+        m_Clients.push_back(raw);
+        std::thread(&ConversionDaemon::HandleClient, this, raw).detach();
+    }
+
+    // let running jobs finish
+    std::unique_lock<std::mutex> lock(m_ClientsMutex);
+    m_ClientsDone.wait(lock, [this]() { return m_Clients.empty(); });
+    m_Server.Close();
+    LOG("Daemon stopped after {0} jobs.", m_NumJobs.load());
+    return true;
+}
+
+void ConversionDaemon::Stop()
+{
+    m_bStop = true;
+
+    std::lock_guard<std::mutex> lock(m_ClientsMutex);
+    for (LocalSocket* client : m_Clients)
+    {
+        client->Shutdown();
+    }
+}
+
+void ConversionDaemon::HandleClient(LocalSocket* client)
+{
+    // progress of concurrently written layers must not interleave
+    std::mutex clientMutex;
+
+    std::string request;
+    while (!m_bStop && client->ReadLine(request))
+    {
+        if (!request.empty())
+        {
+            RunJob(request, *client, clientMutex);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_ClientsMutex);
+    m_Clients.erase(std::find(m_Clients.begin(), m_Clients.end(), client));
+    delete client;
+    m_ClientsDone.notify_all();
+}
+
+void ConversionDaemon::RunJob(const std::string& request, LocalSocket& client, std::mutex& clientMutex)
+{
+    Json job = Json::parse(request, nullptr, false);
+    Json id = job.is_object() && job.contains("id") ? job["id"] : Json();
+
+    auto send = [&client, &clientMutex, &id](Json message)
+    {
+        if (!id.is_null())
+        {
+            message["id"] = id;
+        }
+        std::lock_guard<std::mutex> lock(clientMutex);
+        client.WriteLine(message.dump());
+    };
+
+    if (!job.is_object())
+    {
+        send({ { "event", "error" }, { "message", "Job is not a valid JSON object" } });
+        return;
+    }
+
+    ConvertOptions options = m_Defaults;
+    std::string fileIn;
+    std::string fileOut;
+    std::unordered_set<std::string> layers;
+    try
+    {
+        if (job.value("command", "") == "shutdown")
+        {
+            send({ { "event", "shutdown" } });
+            Stop();
+            return;
+        }
+
+        fileIn = job.value("input", "");
+        fileOut = job.value("output", "");
+        options.bGLTF = job.value("gltf", options.bGLTF);
+        options.textures.bTextures = !options.bGLTF;
+        options.textures.bAtlas = job.value("atlas", options.textures.bAtlas);
+        options.bake.bEnabled = job.value("bakeTerrain", options.bake.bEnabled);
+        options.bSplitLayers = job.value("splitLayers", options.bSplitLayers);
+        options.bSharedModels = job.value("sharedModels", options.bSharedModels);
+        if (job.contains("textureBudget"))
+        {
+            options.textures.budgetBytes = job["textureBudget"].get<uint64_t>() * 1024 * 1024;
+        }
+        if (job.contains("layers"))
+        {
+            for (const Json& layer : job["layers"])
+            {
+                layers.insert(layer.get<std::string>());
+            }
+        }
+    }
+    catch (const Json::exception& e)
+    {
+        send({ { "event", "error" }, { "message", e.what() } });
+        return;
+    }
+
+    if (fileIn.empty())
+    {
+        send({ { "event", "error" }, { "message", "No input LVL given" } });
+        return;
+    }
+    if (fileOut.empty())
+    {
+        fs::path p = fileIn;
+        p.replace_extension(options.bGLTF ? ".gltf" : ".glb");
+        fileOut = p.u8string();
+    }
+
+    const uint32_t jobNumber = ++m_NumJobs;
+    LOG("Job {0}: Converting '{1}'...", jobNumber, fileIn.c_str());
+    send({ { "event", "accepted" }, { "job", jobNumber }, { "input", fileIn }, { "output", fileOut } });
+
+    std::mutex outputsMutex;
+    std::vector<std::string> outputs;
+    options.onProgress = [&](const std::string& stage, const std::string& file)
+    {
+        send({ { "event", "progress" }, { "stage", stage }, { "file", file } });
+        if (stage == "written")
+        {
+            std::lock_guard<std::mutex> lock(outputsMutex);
+            outputs.push_back(file);
+        }
+    };
+
+    LayerFilter isChosen = m_DefaultFilter;
+    if (!layers.empty())
+    {
+        isChosen = [&layers](const std::string& layerName)
+        {
+            return layers.count(layerName) > 0;
+        };
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool bSuccess = convertStandalone(fileIn, m_Common, m_CommonContents, isChosen, options, m_Pool, fileOut);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    grabLibSWBF2Logs();
+
+    Json files = Json::array();
+    for (const std::string& file : outputs)
+    {
+        std::error_code err;
+        uintmax_t size = fs::file_size(file, err);
+        files.push_back({ { "file", file }, { "bytes", err ? 0 : size } });
+    }
+
+    LOG("Job {0}: {1} after {2:.2f}s", jobNumber, bSuccess ? "Done" : "Failed", seconds);
+    Json result = { { "event", bSuccess ? "done" : "error" }, { "job", jobNumber }, { "seconds", seconds }, { "outputs", files } };
+    result["peakMemory"] = getPeakResidentMemory();
+    if (!bSuccess)
+    {
+        result["message"] = "Conversion failed, see the daemon log for details";
+    }
+    send(result);
+}
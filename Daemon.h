@@ -0,0 +1,56 @@
+#pragma once
+#include "Common.h"
+#include "Platform.h"
+#include "WorldConverter.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Keeps the common LVLs loaded and converts world LVLs on request, so a request only
+// pays for the map specific work. Clients connect to a local socket and send one job per line as JSON:
+//
+//   {"input": "geo1.lvl", "output": "out/geo1.glb", "layers": ["geo1_conquest"], "splitLayers": true}
+//
+// Optional job fields: "output", "layers", "gltf", "atlas", "bakeTerrain", "splitLayers",
+// "sharedModels" and "textureBudget" (MB). Anything not given falls back to the options
+// the daemon was started with, without "layers" that's the layers chosen by 'defaultFilter' (default: all).
+// Every job gets answered with JSON lines: "accepted", a "progress" line per stage and
+// finally "done" (with timing, output files and the daemon's peak memory) or "error".
+// Sending {"command": "shutdown"} stops the daemon, just like setting the 'cancelled' flag of 'defaults',
+// which cancels the running jobs as well.
+class ConversionDaemon
+{
+public:
+    ConversionDaemon(
+        const Container* common,
+        const LVLContents* commonContents,
+        const ConvertOptions& defaults,
+        const LayerFilter& defaultFilter,
+        TaskPool& pool
+    );
+    ~ConversionDaemon();
+
+    // Blocks until a shutdown command comes in
+    bool Run(const std::string& socketPath);
+
+private:
+    void HandleClient(LocalSocket* client);
+    void RunJob(const std::string& request, LocalSocket& client, std::mutex& clientMutex);
+    void Stop();
+
+    const Container* m_Common;
+    const LVLContents* m_CommonContents;
+    ConvertOptions m_Defaults;
+    LayerFilter m_DefaultFilter;
+    TaskPool& m_Pool;
+
+    LocalSocket m_Server;
+    std::atomic<bool> m_bStop = false;
+    std::atomic<uint32_t> m_NumJobs = 0;
+
+    // every client runs on its own detached thread
+    std::mutex m_ClientsMutex;
+    std::condition_variable m_ClientsDone;
+    std::vector<LocalSocket*> m_Clients;
+};
@@ -0,0 +1,401 @@
+#include "FastPNG.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+// aim for roughly this many uncompressed bytes per parallel block
+constexpr size_t BLOCK_TARGET_SIZE = 256 * 1024;
+
+constexpr uint32_t HASH_BITS = 15;
+constexpr uint32_t WINDOW_SIZE = 32768;
+constexpr uint32_t MIN_MATCH = 4;
+constexpr uint32_t MAX_MATCH = 258;
+constexpr uint32_t ADLER_BASE = 65521;
+
+
+namespace
+{
+    struct HuffmanCode
+    {
+        uint16_t m_Bits;
+        uint8_t m_Length;
+    };
+
+    struct ExtraCode
+    {
+        uint16_t m_Symbol;
+        uint8_t m_ExtraBits;
+        uint16_t m_ExtraValue;
+    };
+
+    struct Tables
+    {
+        // fixed literal/length Huffman codes, already bit reversed
+        std::array<HuffmanCode, 288> m_LitLen;
+        // match length (3..258) -> length symbol
+        std::array<ExtraCode, MAX_MATCH + 1> m_Length;
+        // distance (1..32768) -> distance symbol, see GetDistance()
+        std::array<uint8_t, 512> m_DistSymbol;
+        std::array<uint16_t, 30> m_DistBase;
+        std::array<uint8_t, 30> m_DistExtra;
+        // fixed distance codes are just the 5 bit symbol, bit reversed
+        std::array<uint8_t, 30> m_DistCode;
+        std::array<uint32_t, 256> m_CRC;
+
+        Tables()
+        {
+            auto reverse = [](uint32_t code, uint32_t length)
+            {
+                uint32_t result = 0;
+                for (uint32_t i = 0; i < length; ++i)
+                {
+                    result |= ((code >> i) & 1) << (length - 1 - i);
+                }
+                return (uint16_t)result;
+            };
+
+            for (uint32_t i = 0; i < 288; ++i)
+            {
+                if (i < 144)      m_LitLen[i] = { reverse(0x30 + i, 8), 8 };
+                else if (i < 256) m_LitLen[i] = { reverse(0x190 + i - 144, 9), 9 };
+                else if (i < 280) m_LitLen[i] = { reverse(i - 256, 7), 7 };
+                else              m_LitLen[i] = { reverse(0xC0 + i - 280, 8), 8 };
+            }
+
+            static const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+            static const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+            for (uint32_t sym = 0; sym < 29; ++sym)
+            {
+                uint32_t end = sym + 1 < 29 ? LENGTH_BASE[sym + 1] : MAX_MATCH + 1;
+                for (uint32_t len = LENGTH_BASE[sym]; len < end; ++len)
+                {
+                    m_Length[len] = { (uint16_t)(257 + sym), LENGTH_EXTRA[sym], (uint16_t)(len - LENGTH_BASE[sym]) };
+                }
+            }
+
+            static const uint16_t DIST_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+            for (uint32_t sym = 0; sym < 30; ++sym)
+            {
+                m_DistBase[sym] = DIST_BASE[sym];
+                m_DistExtra[sym] = sym < 4 ? 0 : (uint8_t)((sym - 2) / 2);
+                m_DistCode[sym] = (uint8_t)reverse(sym, 5);
+                uint32_t end = sym + 1 < 30 ? DIST_BASE[sym + 1] : WINDOW_SIZE + 1;
+                for (uint32_t dist = DIST_BASE[sym]; dist < end; ++dist)
+                {
+                    // same split as zlib: exact for the first 256 distances, in steps of 128 above
+                    uint32_t idx = dist <= 256 ? dist - 1 : 256 + ((dist - 1) >> 7);
+                    m_DistSymbol[idx] = (uint8_t)sym;
+                }
+            }
+
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (uint32_t k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                m_CRC[i] = c;
+            }
+        }
+
+        uint8_t GetDistance(uint32_t dist) const
+        {
+            return m_DistSymbol[dist <= 256 ? dist - 1 : 256 + ((dist - 1) >> 7)];
+        }
+    };
+
+    const Tables& getTables()
+    {
+        static const Tables tables;
+        return tables;
+    }
+
+    // Writes into a buffer that has to be preallocated large enough by the caller
+    class BitWriter
+    {
+    public:
+        BitWriter(uint8_t* out) : m_Start(out), m_Out(out) {}
+
+        // at most 32 bits at once
+        void Write(uint32_t bits, uint32_t count)
+        {
+            m_Buffer |= (uint64_t)bits << m_Count;
+            m_Count += count;
+            if (m_Count >= 32)
+            {
+                uint32_t word = (uint32_t)m_Buffer;
+                m_Out[0] = (uint8_t)word;
+                m_Out[1] = (uint8_t)(word >> 8);
+                m_Out[2] = (uint8_t)(word >> 16);
+                m_Out[3] = (uint8_t)(word >> 24);
+                m_Out += 4;
+                m_Buffer >>= 32;
+                m_Count -= 32;
+            }
+        }
+
+        void AlignToByte()
+        {
+            if (m_Count % 8 != 0)
+            {
+                Write(0, 8 - m_Count % 8);
+            }
+            while (m_Count > 0)
+            {
+                *m_Out++ = (uint8_t)m_Buffer;
+                m_Buffer >>= 8;
+                m_Count -= 8;
+            }
+        }
+
+        void WriteBytes(const uint8_t* bytes, size_t count)
+        {
+            std::memcpy(m_Out, bytes, count);
+            m_Out += count;
+        }
+
+        size_t GetSize() const
+        {
+            return m_Out - m_Start;
+        }
+
+    private:
+        uint8_t* m_Start;
+        uint8_t* m_Out;
+        uint64_t m_Buffer = 0;
+        uint32_t m_Count = 0;
+    };
+
+    uint32_t adler32(const uint8_t* data, size_t size)
+    {
+        uint32_t a = 1, b = 0;
+        while (size > 0)
+        {
+            // largest n such that b can't overflow before the modulo
+            size_t n = std::min(size, (size_t)5552);
+            size -= n;
+            for (size_t i = 0; i < n; ++i)
+            {
+                a += data[i];
+                b += a;
+            }
+            data += n;
+            a %= ADLER_BASE;
+            b %= ADLER_BASE;
+        }
+        return (b << 16) | a;
+    }
+
+    // adler32 of the concatenation A + B, from the adlers of A and B (see zlib's adler32_combine)
+    uint32_t adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t sizeB)
+    {
+        uint32_t rem = (uint32_t)(sizeB % ADLER_BASE);
+        uint32_t sum1 = adlerA & 0xFFFF;
+        uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % ADLER_BASE);
+        sum1 += (adlerB & 0xFFFF) + ADLER_BASE - 1;
+        sum2 += ((adlerA >> 16) & 0xFFFF) + ((adlerB >> 16) & 0xFFFF) + ADLER_BASE - rem;
+        if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+        if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+        if (sum2 >= (ADLER_BASE << 1)) sum2 -= (ADLER_BASE << 1);
+        if (sum2 >= ADLER_BASE) sum2 -= ADLER_BASE;
+        return sum1 | (sum2 << 16);
+    }
+
+    uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        const Tables& tables = getTables();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc = tables.m_CRC[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    uint32_t read32(const uint8_t* p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    // Compresses 'data' into a non-final fixed Huffman block, followed by an
+    // empty stored block so the output ends on a byte boundary and can be
+    // concatenated with the output of other blocks.
+    void deflateBlock(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+    {
+        const Tables& tables = getTables();
+        std::vector<int32_t> hashTable((size_t)1 << HASH_BITS, -1);
+
+        // worst case is 9 bits per literal, plus block headers and the trailing stored block
+        out.resize(size + size / 8 + 16);
+        BitWriter writer(out.data());
+        writer.Write(0, 1); // BFINAL
+        writer.Write(1, 2); // BTYPE = fixed Huffman
+
+        auto writeLiteral = [&](uint8_t value)
+        {
+            const HuffmanCode& code = tables.m_LitLen[value];
+            writer.Write(code.m_Bits, code.m_Length);
+        };
+
+        size_t i = 0;
+        while (i + MIN_MATCH <= size)
+        {
+            uint32_t word = read32(data + i);
+            uint32_t hash = (word * 2654435761u) >> (32 - HASH_BITS);
+            int32_t candidate = hashTable[hash];
+            hashTable[hash] = (int32_t)i;
+
+            if (candidate >= 0 && i - candidate <= WINDOW_SIZE && read32(data + candidate) == word)
+            {
+                size_t maxLength = std::min(size - i, (size_t)MAX_MATCH);
+                size_t length = MIN_MATCH;
+                while (length < maxLength && data[candidate + length] == data[i + length])
+                {
+                    length++;
+                }
+
+                const ExtraCode& len = tables.m_Length[length];
+                const HuffmanCode& lenCode = tables.m_LitLen[len.m_Symbol];
+                writer.Write(lenCode.m_Bits, lenCode.m_Length);
+                writer.Write(len.m_ExtraValue, len.m_ExtraBits);
+
+                uint32_t distance = (uint32_t)(i - candidate);
+                uint8_t distSymbol = tables.GetDistance(distance);
+                writer.Write(tables.m_DistCode[distSymbol], 5);
+                writer.Write(distance - tables.m_DistBase[distSymbol], tables.m_DistExtra[distSymbol]);
+
+                i += length;
+            }
+            else
+            {
+                writeLiteral(data[i]);
+                i++;
+            }
+        }
+        for (; i < size; ++i)
+        {
+            writeLiteral(data[i]);
+        }
+
+        const HuffmanCode& endOfBlock = tables.m_LitLen[256];
+        writer.Write(endOfBlock.m_Bits, endOfBlock.m_Length);
+
+        // empty stored block: BFINAL = 0, BTYPE = 00, aligned LEN = 0, NLEN = 0xFFFF
+        writer.Write(0, 3);
+        writer.AlignToByte();
+        static const uint8_t EMPTY_STORED[4] = { 0x00, 0x00, 0xFF, 0xFF };
+        writer.WriteBytes(EMPTY_STORED, 4);
+        out.resize(writer.GetSize());
+    }
+
+    void writeBigEndian(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back((uint8_t)(value >> 24));
+        out.push_back((uint8_t)(value >> 16));
+        out.push_back((uint8_t)(value >> 8));
+        out.push_back((uint8_t)value);
+    }
+
+    void writeChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+    {
+        writeBigEndian(out, (uint32_t)size);
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data, data + size);
+        writeBigEndian(out, crc32(0, &out[start], size + 4));
+    }
+}
+
+
+bool encodePNGFast(uint32_t width, uint32_t height, const uint8_t* rgba, std::vector<uint8_t>& outPNG, TaskPool* pool)
+{
+    outPNG.clear();
+    if (width == 0 || height == 0 || rgba == nullptr)
+    {
+        return false;
+    }
+
+    const size_t pitch = (size_t)width * 4;
+    const size_t filteredPitch = pitch + 1;
+    const uint32_t rowsPerBlock = (uint32_t)std::clamp(BLOCK_TARGET_SIZE / filteredPitch, (size_t)1, (size_t)height);
+    const uint32_t numBlocks = (height + rowsPerBlock - 1) / rowsPerBlock;
+
+    struct Block
+    {
+        std::vector<uint8_t> m_Compressed;
+        uint32_t m_Adler;
+        size_t m_Size;
+    };
+    std::vector<Block> blocks(numBlocks);
+
+    parallelFor(pool, numBlocks, [&](uint32_t blockIdx)
+    {
+        const uint32_t rowStart = blockIdx * rowsPerBlock;
+        const uint32_t rowEnd = std::min(rowStart + rowsPerBlock, height);
+
+        std::vector<uint8_t> filtered((size_t)(rowEnd - rowStart) * filteredPitch);
+        for (uint32_t row = rowStart; row < rowEnd; ++row)
+        {
+            uint8_t* dst = &filtered[(size_t)(row - rowStart) * filteredPitch];
+            const uint8_t* src = rgba + row * pitch;
+            if (row == 0)
+            {
+                // filter type 'None'
+                dst[0] = 0;
+                std::memcpy(dst + 1, src, pitch);
+            }
+            else
+            {
+                // filter type 'Up'
+                const uint8_t* above = src - pitch;
+                dst[0] = 2;
+                for (size_t x = 0; x < pitch; ++x)
+                {
+                    dst[x + 1] = (uint8_t)(src[x] - above[x]);
+                }
+            }
+        }
+
+        Block& block = blocks[blockIdx];
+        block.m_Adler = adler32(filtered.data(), filtered.size());
+        block.m_Size = filtered.size();
+        deflateBlock(filtered.data(), filtered.size(), block.m_Compressed);
+    });
+
+    // zlib stream: header, all blocks, final empty fixed Huffman block, adler32
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    uint32_t adler = 1;
+    for (const Block& block : blocks)
+    {
+        zlib.insert(zlib.end(), block.m_Compressed.begin(), block.m_Compressed.end());
+        adler = adler32Combine(adler, block.m_Adler, block.m_Size);
+    }
+    zlib.insert(zlib.end(), { 0x03, 0x00 });
+    writeBigEndian(zlib, adler);
+
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    outPNG.insert(outPNG.end(), SIGNATURE, SIGNATURE + 8);
+
+    uint8_t header[13];
+    header[0] = (uint8_t)(width >> 24);
+    header[1] = (uint8_t)(width >> 16);
+    header[2] = (uint8_t)(width >> 8);
+    header[3] = (uint8_t)width;
+    header[4] = (uint8_t)(height >> 24);
+    header[5] = (uint8_t)(height >> 16);
+    header[6] = (uint8_t)(height >> 8);
+    header[7] = (uint8_t)height;
+    header[8] = 8;  // bit depth
+    header[9] = 6;  // color type RGBA
+    header[10] = 0; // compression
+    header[11] = 0; // filter
+    header[12] = 0; // no interlace
+    writeChunk(outPNG, "IHDR", header, sizeof(header));
+    writeChunk(outPNG, "IDAT", zlib.data(), zlib.size());
+    writeChunk(outPNG, "IEND", nullptr, 0);
+    return true;
+}
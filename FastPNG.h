@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class TaskPool;
+
+// Single pass RGBA8 PNG encoder, trading some compression ratio for speed.
+// Every row gets the 'Up' filter, followed by a greedy LZ77 pass with fixed Huffman codes.
+// Large images are split into blocks of rows that get compressed in parallel on 'pool' (if given),
+// each one as an independent, byte aligned part of the same deflate stream.
+bool encodePNGFast(uint32_t width, uint32_t height, const uint8_t* rgba, std::vector<uint8_t>& outPNG, TaskPool* pool = nullptr);
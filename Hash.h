@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// Fast non-cryptographic 64 bit hash, used to key the on-disk caches.
+// Consumes 8 bytes per step, so hashing multi MB texture payloads stays cheap.
+class Hasher
+{
+public:
+    Hasher(uint64_t seed = 0) : m_State(seed ^ 0x9E3779B97F4A7C15ull) {}
+
+    Hasher& Add(const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            Mix(word);
+        }
+
+        uint64_t tail = 0;
+        std::memcpy(&tail, bytes + i, size - i);
+        Mix(tail ^ ((uint64_t)size << 56));
+        return *this;
+    }
+
+    template<class T>
+    Hasher& Add(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be hashed directly!");
+        return Add(&value, sizeof(T));
+    }
+
+    Hasher& Add(const std::string& str)
+    {
+        return Add(str.data(), str.size());
+    }
+
+    uint64_t Get() const
+    {
+        // final avalanche (murmur3 fmix64)
+        uint64_t h = m_State;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+private:
+    void Mix(uint64_t word)
+    {
+        word *= 0x87C37B91114253D5ull;
+        word = (word << 31) | (word >> 33);
+        word *= 0x4CF5AD432745937Full;
+        m_State ^= word;
+        m_State = (m_State << 27) | (m_State >> 37);
+        m_State = m_State * 5 + 0x52DCE729;
+    }
+
+    uint64_t m_State;
+};
+
+// 32 bit FNV-1a of the lower case name, as the game and LibSWBF2 use it for
+// sub LVL ('lvl_' chunk) names (e.g. "geo1_conquest") and property names.
+inline uint32_t fnvHash(const std::string& name)
+{
+    uint32_t hash = 2166136261u;
+    for (char c : name)
+    {
+        hash ^= (uint8_t)((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,86 @@
+#include "Journal.h"
+#include "Common.h"
+#include "Hash.h"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+bool ConversionJournal::Open(const std::string& path, bool bResume)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Done.clear();
+    bool bCutOff = false;
+    if (bResume)
+    {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            // the last line may be cut off, if the process got killed while writing it. Then the output
+            // path may be incomplete as well, so that file gets converted again
+            bCutOff = in.eof();
+            const size_t space = line.find(' ');
+            if (bCutOff || space != 16 || line.size() <= space + 1)
+            {
+                continue;
+            }
+            uint64_t key = 0;
+            try
+            {
+                key = std::stoull(line.substr(0, space), nullptr, 16);
+            }
+            catch (const std::exception&)
+            {
+                continue;
+            }
+            m_Done.emplace(key, line.substr(space + 1));
+        }
+    }
+
+    m_File.open(path, bResume ? std::ios::app : std::ios::trunc);
+    if (!m_File)
+    {
+        LOG("Could not open journal '{0}'!", path.c_str());
+        return false;
+    }
+    if (bCutOff)
+    {
+        m_File << std::endl;
+    }
+    if (bResume)
+    {
+        LOG("Resuming with {0} output files already done, according to '{1}'.", m_Done.size(), path.c_str());
+    }
+    return true;
+}
+
+bool ConversionJournal::IsOpen() const
+{
+    return m_File.is_open();
+}
+
+uint64_t ConversionJournal::StampFile(const std::string& path)
+{
+    std::error_code err;
+    const uint64_t size = fs::file_size(path, err);
+    const int64_t time = (int64_t)fs::last_write_time(path, err).time_since_epoch().count();
+    return Hasher().Add(size).Add(time).Get();
+}
+
+bool ConversionJournal::IsDone(uint64_t key, const std::string& fileOut) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::error_code err;
+    return m_Done.count({ key, fileOut }) > 0 && fs::exists(fileOut, err);
+}
+
+void ConversionJournal::MarkDone(uint64_t key, const std::string& fileOut)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Done.emplace(key, fileOut).second && m_File.is_open())
+    {
+        // flushed right away, the process may get killed any moment
+        m_File << fmt::format("{0:016x} {1}", key, fileOut) << std::endl;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+// Remembers which output files of a long running export are complete, so an interrupted export can resume
+// instead of starting over. Every finished output file gets appended right away, as one line of text:
+//
+//   <key as 16 hex digits> <output file>
+//
+// The key stands for everything the output depends on (input LVL, common LVLs, options, chosen layers),
+// so entries of other exports into the same output files don't count.
+class ConversionJournal
+{
+public:
+    // Unless resuming, earlier entries get discarded
+    bool Open(const std::string& path, bool bResume);
+    bool IsOpen() const;
+
+    // Changes whenever the file's size or modification time does. Cheap compared to hashing its content.
+    static uint64_t StampFile(const std::string& path);
+
+    bool IsDone(uint64_t key, const std::string& fileOut) const;
+    void MarkDone(uint64_t key, const std::string& fileOut);
+
+private:
+    mutable std::mutex m_Mutex;
+    std::ofstream m_File;
+    std::set<std::pair<uint64_t, std::string>> m_Done;
+};
@@ -1,244 +1,756 @@
-#include <iostream>
-#include <fmt/format.h>
-#include <fmt/printf.h>
 #include <CLI11.hpp>
-#include <LibSWBF2.h>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <regex>
+#include <set>
+#include <thread>
+#include <json.hpp>
 
-#define TINYGLTF_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <tiny_gltf.h>
+#include "Common.h"
+#include "BatchScheduler.h"
+#include "Coordinator.h"
+#include "WorldConverter.h"
+#include "Daemon.h"
+#include "Hash.h"
+#include "Journal.h"
+#include "Platform.h"
+#include <csignal>
 
 namespace fs = std::filesystem;
 
-#define LOG(formatStr, ...) std::cout << fmt::format(formatStr, __VA_ARGS__) << std::endl;
-
-using LibSWBF2::Logging::Logger;
-using LibSWBF2::Logging::LoggerEntry;
-using LibSWBF2::ELogType;
-using LibSWBF2::Level;
-using LibSWBF2::Container;
-using LibSWBF2::SWBF2Handle;
-using LibSWBF2::ETopology;
-using LibSWBF2::Types::List;
-using LibSWBF2::Types::Vector2;
-using LibSWBF2::Types::Vector3;
-using LibSWBF2::Types::Vector4;
-using LibSWBF2::Types::String;
-using LibSWBF2::Types::Color4u8;
-using LibSWBF2::Wrappers::World;
-using LibSWBF2::Wrappers::Terrain;
-using LibSWBF2::Wrappers::Instance;
-using LibSWBF2::Wrappers::Model;
-using LibSWBF2::Wrappers::Segment;
-using LibSWBF2::Wrappers::Material;
+// set on SIGINT / SIGTERM. Conversions stop at the next model then, without writing their output
+static std::atomic<bool> s_bCancelled = false;
+
+static void onCancelSignal(int signal)
+{
+    // the second time, don't wait for anything
+    if (s_bCancelled.exchange(true))
+    {
+        std::_Exit(128 + signal);
+    }
+}
 
 
 bool grabLibSWBF2Logs()
 {
-    bool bLogged = false;
+    // drain everything that piled up and print it in one go
+    std::string batch;
     LoggerEntry logEntry;
     while (Logger::GetNextLog(logEntry))
     {
-        LOG(logEntry.ToString().Buffer());
-        bLogged = true;
+        batch += logEntry.ToString().Buffer();
+        batch += '\n';
+    }
+    if (batch.empty())
+    {
+        return false;
+    }
+    std::cout << batch << std::flush;
+    return true;
+}
+
+// Prints the loading progress until 'isReady' returns true or everything is loaded.
+// LibSWBF2 has no completion event to wait on, so poll with a backoff up to a fixed
+// refresh rate instead of spinning. Leaves the cores to the loader threads.
+template<class Func>
+void waitForLoading(Container* con, const std::string& filename, Func isReady)
+{
+    constexpr auto MIN_POLL_INTERVAL = std::chrono::milliseconds(5);
+    constexpr auto MAX_POLL_INTERVAL = std::chrono::milliseconds(100);
+    auto pollInterval = MIN_POLL_INTERVAL;
+    int lastProgress = -1;
+    char updateLine[80] = {' '};
+    bool bPrinted = false;
+    while (!con->IsDone() && !isReady())
+    {
+        bPrinted = true;
+        std::this_thread::sleep_for(pollInterval);
+        pollInterval = std::min(pollInterval * 2, MAX_POLL_INTERVAL);
+
+        int progress = (int)(con->GetOverallProgress() * 100.0f);
+        if (grabLibSWBF2Logs())
+        {
+            LOG("Loading '{0}'... {1}%", filename.c_str(), progress);
+            lastProgress = progress;
+        }
+        else if (progress != lastProgress)
+        {
+            std::memset(updateLine, ' ', 80);
+            fmt::format_to(updateLine, "Loading '{0}'... {1}%", filename.c_str(), progress);
+            updateLine[79] = 0;
+            std::cout << '\r' << updateLine << std::flush;
+            lastProgress = progress;
+        }
+    }
+    if (bPrinted)
+    {
+        LOG("");
+    }
+}
+
+// Everything but the input LVL the output files depend on, for the journal
+uint64_t hashOutputSettings(const ConvertOptions& options, const std::string& fileCom, const std::string& layerPattern, bool bAllLayers)
+{
+    const TextureStageOptions& tex = options.textures;
+    Hasher hasher;
+    hasher.Add(options.bGLTF).Add(options.bSplitLayers).Add(options.bSharedModels);
+    hasher.Add(tex.bTextures).Add(tex.bAtlas).Add(tex.atlasMaxSize).Add(tex.atlasPageSize).Add(tex.budgetBytes).Add(tex.bFastPNG);
+    hasher.Add(options.bake.bEnabled).Add(options.bake.tilesPerSide).Add(options.bake.tileResolution);
+    hasher.Add(layerPattern).Add(bAllLayers);
+    if (!fileCom.empty())
+    {
+        hasher.Add(ConversionJournal::StampFile(fileCom));
+    }
+    return hasher.Get();
+}
+
+void logPeakMemory()
+{
+    const uint64_t peak = getPeakResidentMemory();
+    if (peak > 0)
+    {
+        LOG("Peak memory usage: {0} MB", peak / (1024 * 1024));
+    }
+}
+
+void printMenu(const std::vector<std::string>& worldNames, std::vector<bool>& chosenWorlds)
+{
+    LOG("Choose which Layers to convert:");
+    for (size_t i = 0; i < worldNames.size(); ++i)
+    {
+        LOG("  {0:2d}) [{1}] {2}", i + 1, chosenWorlds[i] ? 'X' : ' ', worldNames[i]);
+    }
+    LOG("\n  {0:2d}) Select all", worldNames.size() + 1);
+    LOG("  {0:2d}) Remove all", worldNames.size() + 2);
+    LOG("   0) Start conversion");
+}
+
+// Reads one LVL path per line. Empty lines and lines starting with '#' are skipped.
+// Relative paths are relative to the manifest file itself.
+bool readManifest(const std::string& manifestPath, std::vector<std::string>& outFiles)
+{
+    std::ifstream manifest(manifestPath);
+    if (!manifest)
+    {
+        LOG("Could not open manifest '{0}'!", manifestPath.c_str());
+        return false;
+    }
+
+    const fs::path baseDir = fs::path(manifestPath).parent_path();
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        size_t start = line.find_first_not_of(" \t\r");
+        size_t end = line.find_last_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#')
+        {
+            continue;
+        }
+
+        fs::path path = line.substr(start, end - start + 1);
+        if (path.is_relative())
+        {
+            path = baseDir / path;
+        }
+        outFiles.emplace_back(path.u8string());
     }
-    return bLogged;
+    return true;
 }
 
-void convertColor(const Color4u8& swbfColor, std::vector<double>& outColor)
+// Prints the layers of every given world LVL as one JSON line per file, e.g.
+//   {"file":"geo1.lvl","layers":[{"name":"geo1","instances":412},{"name":"geo1_conquest","instances":57}]}
+// Only the chunk headers get read, nothing is loaded.
+int listLayers(const std::vector<std::string>& filesIn)
 {
-    outColor.resize(4);
-    outColor[0] = swbfColor.m_Red / 255.0;
-    outColor[1] = swbfColor.m_Green / 255.0;
-    outColor[2] = swbfColor.m_Blue / 255.0;
-    outColor[3] = swbfColor.m_Alpha / 255.0;
+    int result = 0;
+    for (const std::string& fileIn : filesIn)
+    {
+        LVLContents contents;
+        if (!scanLVL(fileIn, contents))
+        {
+            result = 1;
+            continue;
+        }
+
+        nlohmann::json layers = nlohmann::json::array();
+        for (const LayerInfo& layer : contents.m_Layers)
+        {
+            layers.push_back({ { "name", layer.m_Name }, { "instances", layer.m_NumInstances } });
+        }
+
+        nlohmann::json line = { { "file", fileIn }, { "layers", layers } };
+        std::cout << line.dump() << std::endl;
+    }
+    return result;
 }
 
-void copyBuffer(Vector3* srcBuffer, uint32_t srcCount, tinygltf::Buffer& dstBuffer, int dstOffset)
+// Loads the common LVLs (e.g. ingame.lvl) into a container of their own and waits for them.
+// Also scans them, to resolve entity classes when loading world LVLs selectively.
+// Returns nullptr if there's nothing to load.
+Container* loadCommon(const std::string& fileCom, LVLContents& outContents)
 {
-    for (uint32_t i = 0; i < srcCount; ++i)
+    if (fileCom.empty())
+    {
+        return nullptr;
+    }
+    if (!fs::exists(fileCom))
     {
-        int vecIdx = dstOffset + i * sizeof(float) * 3;
-        *reinterpret_cast<float*>(&dstBuffer.data[vecIdx])                     = srcBuffer[i].m_X;
-        *reinterpret_cast<float*>(&dstBuffer.data[vecIdx + sizeof(float)])     = srcBuffer[i].m_Y;
-        *reinterpret_cast<float*>(&dstBuffer.data[vecIdx + sizeof(float) * 2]) = srcBuffer[i].m_Z;
+        LOG("Could not find '{0}'!", fileCom.c_str());
+        return nullptr;
     }
+
+    scanLVL(fileCom, outContents);
+
+    std::string comName = fs::path(fileCom).filename().u8string();
+    LOG("Start Loading '{0}'...", comName.c_str());
+    Container* con = Container::Create();
+    con->AddLevel(fileCom.c_str());
+    con->StartLoading();
+    waitForLoading(con, comName, []() { return false; });
+    grabLibSWBF2Logs();
+    return con;
 }
 
-void copyBuffer(Vector2* srcBuffer, uint32_t srcCount, tinygltf::Buffer& dstBuffer, int dstOffset)
+bool createOutputDir(const std::string& outDir)
 {
-    for (uint32_t i = 0; i < srcCount; ++i)
+    if (outDir.empty())
     {
-        int vecIdx = dstOffset + i * sizeof(float) * 2;
-        *reinterpret_cast<float*>(&dstBuffer.data[vecIdx])                 = srcBuffer[i].m_X;
-        *reinterpret_cast<float*>(&dstBuffer.data[vecIdx + sizeof(float)]) = srcBuffer[i].m_Y;
+        return true;
     }
+    std::error_code err;
+    fs::create_directories(outDir, err);
+    if (err)
+    {
+        LOG("Could not create output directory '{0}': {1}", outDir.c_str(), err.message().c_str());
+        return false;
+    }
+    return true;
+}
+
+// Output file of a world LVL in batch mode, next to it unless there's an output directory
+std::string getBatchOutput(const std::string& fileIn, const std::string& outDir, const ConvertOptions& options)
+{
+    fs::path outPath = fileIn;
+    outPath.replace_extension(options.bGLTF ? ".gltf" : ".glb");
+    if (!outDir.empty())
+    {
+        outPath = fs::path(outDir) / outPath.filename();
+    }
+    return outPath.u8string();
 }
 
-void copyBuffer(uint16_t* srcBuffer, uint32_t srcCount, tinygltf::Buffer& dstBuffer, int dstOffset)
+// Converts the chosen layers (all, without 'isChosen') of every given world LVL into its own output file. The common LVLs are loaded only
+// once and stay resident, while every world LVL gets loaded on its own and freed right after its conversion.
+// With 'maxMemoryBytes', up to 'numParallel' LVLs get converted at the same time as long as their estimated memory fits.
+int convertBatch(
+    const std::vector<std::string>& filesIn,
+    const std::string& fileCom,
+    const std::string& outDir,
+    const LayerFilter& isChosen,
+    uint32_t numParallel,
+    uint64_t maxMemoryBytes,
+    const ConvertOptions& options,
+    TaskPool& pool
+)
 {
-    for (uint32_t i = 0; i < srcCount; ++i)
+    if (!createOutputDir(outDir))
+    {
+        return 1;
+    }
+
+    LVLContents comContents;
+    Container* con = loadCommon(fileCom, comContents);
+
+    // the scan only reads the chunk headers, so estimating upfront is cheap
+    BatchScheduler scheduler(maxMemoryBytes);
+    for (uint32_t idx = 0; idx < filesIn.size(); ++idx)
+    {
+        LVLContents contents;
+        const uint64_t estimate = maxMemoryBytes > 0 && scanLVL(filesIn[idx], contents) ? estimateJobMemory(contents, options) : 0;
+        if (estimate > maxMemoryBytes && maxMemoryBytes > 0)
+        {
+            LOG("'{0}' probably needs {1} MB on its own, more than --max-ram allows. It will be converted alone.", filesIn[idx].c_str(), estimate / (1024 * 1024));
+        }
+        scheduler.Add(idx, estimate);
+    }
+
+    std::atomic<uint32_t> numFailed = 0;
+    auto convertNext = [&]()
+    {
+        uint32_t idx;
+        while (scheduler.Next(idx))
+        {
+            if (options.cancelled != nullptr && *options.cancelled)
+            {
+                numFailed++;
+                scheduler.Done(idx);
+                continue;
+            }
+            const std::string& fileIn = filesIn[idx];
+
+            // the LVL this thread most likely gets next, can be read from disk while this one converts
+            MappedFile upcoming;
+            uint32_t upcomingIdx;
+            if (scheduler.GetPending(numParallel - 1, upcomingIdx) && upcoming.Open(filesIn[upcomingIdx]))
+            {
+                upcoming.Prefetch();
+            }
+
+            LOG("[{0}/{1}] Converting '{2}'...", idx + 1, filesIn.size(), fileIn.c_str());
+            if (!convertStandalone(fileIn, con, con != nullptr ? &comContents : nullptr, isChosen, options, pool, getBatchOutput(fileIn, outDir, options)))
+            {
+                numFailed++;
+            }
+            scheduler.Done(idx);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < numParallel; ++i)
     {
-        int vecIdx = dstOffset + i * sizeof(uint16_t);
-        *reinterpret_cast<uint16_t*>(&dstBuffer.data[vecIdx]) = srcBuffer[i];
+        threads.emplace_back(convertNext);
     }
+    convertNext();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    if (con != nullptr)
+    {
+        con->FreeAll();
+        Container::Delete(con);
+    }
+    grabLibSWBF2Logs();
+
+    LOG("Converted {0} of {1} LVLs.", filesIn.size() - numFailed, filesIn.size());
+    if (options.cancelled != nullptr && *options.cancelled && options.journal != nullptr)
+    {
+        LOG("Cancelled. Run again with --resume to continue where this run stopped.");
+    }
+    return numFailed > 0 ? 1 : 0;
 }
 
-inline void copyBuffers(
-    Vector3*  swbfVertexBuffer,
-    uint32_t  swbfVertexBufferCount,
-    Vector3*  swbfNormalBuffer,
-    uint32_t  swbfNormalBufferCount,
-    Vector2*  swbfUVBuffer,
-    uint32_t  swbfUVBufferCount,
-    uint16_t* swbfIndexBuffer,
-    uint32_t  swbfIndexBufferCount,
-    tinygltf::Model& dstModel,
-    int& gltfVertexBufferAccIdx,
-    int& gltfNormalBufferAccIdx,
-    int& gltfUVBufferAccIdx,
-    int& gltfIndexBufferAccIdx
+// The command line of every worker process of --workers, converting with the same options as this process.
+// Built from the parsed values, every value in '--name=value' form, so values starting with '-' stay values.
+// Unless given, the hardware threads get split up between the workers.
+std::vector<std::string> getWorkerArgs(
+    const ConvertOptions& options,
+    const std::string& fileCom,
+    uint32_t textureBudgetMB,
+    const std::string& layerPattern,
+    bool bAllLayers,
+    const std::string& parseCacheDir,
+    uint32_t numWorkers,
+    uint32_t numThreads
 )
 {
-    int segmBufferIdx = 0;
-    int offset = 0;
-
-    uint32_t swbfVertexBufferSize = swbfVertexBufferCount * sizeof(float) * 3;
-    uint32_t swbfNormalBufferSize = swbfNormalBufferCount * sizeof(float) * 3;
-    uint32_t swbfUVBufferSize = swbfUVBufferCount * sizeof(float) * 2;
-    uint32_t swbfIndexBufferSize = swbfIndexBufferCount * sizeof(uint16_t);
-
-    tinygltf::Buffer& segmBuffer = dstModel.buffers.emplace_back();
-    segmBufferIdx = (int)dstModel.buffers.size() - 1;
-    segmBuffer.data.resize(
-        (size_t)swbfVertexBufferSize +
-        (size_t)swbfNormalBufferSize +
-        (size_t)swbfUVBufferSize +
-        (size_t)swbfIndexBufferSize
-    );
-
-    {
-        copyBuffer(swbfVertexBuffer, swbfVertexBufferCount, segmBuffer, offset);
-        tinygltf::BufferView& view = dstModel.bufferViews.emplace_back();
-        view.buffer = segmBufferIdx;
-        view.byteOffset = offset;
-        view.byteLength = swbfVertexBufferSize;
-        view.byteStride = sizeof(float) * 3;
-        offset += swbfVertexBufferSize;
-        tinygltf::Accessor& acc = dstModel.accessors.emplace_back();
-        gltfVertexBufferAccIdx = (int)dstModel.accessors.size() - 1;
-        acc.bufferView = (int)dstModel.bufferViews.size() - 1;
-        acc.byteOffset = 0;
-        acc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-        acc.type = TINYGLTF_TYPE_VEC3;
-        acc.count = swbfVertexBufferCount;
-    }
-    {
-        copyBuffer(swbfNormalBuffer, swbfNormalBufferCount, segmBuffer, offset);
-        tinygltf::BufferView& view = dstModel.bufferViews.emplace_back();
-        view.buffer = segmBufferIdx;
-        view.byteOffset = offset;
-        view.byteLength = swbfNormalBufferSize;
-        view.byteStride = sizeof(float) * 3;
-        offset += swbfNormalBufferSize;
-        tinygltf::Accessor& acc = dstModel.accessors.emplace_back();
-        gltfNormalBufferAccIdx = (int)dstModel.accessors.size() - 1;
-        acc.bufferView = (int)dstModel.bufferViews.size() - 1;
-        acc.byteOffset = 0;
-        acc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-        acc.type = TINYGLTF_TYPE_VEC3;
-        acc.count = swbfNormalBufferCount;
-    }
-    {
-        copyBuffer(swbfUVBuffer, swbfUVBufferCount, segmBuffer, offset);
-        tinygltf::BufferView& view = dstModel.bufferViews.emplace_back();
-        view.buffer = segmBufferIdx;
-        view.byteOffset = offset;
-        view.byteLength = swbfUVBufferSize;
-        view.byteStride = sizeof(float) * 2;
-        offset += swbfUVBufferSize;
-        tinygltf::Accessor& acc = dstModel.accessors.emplace_back();
-        gltfUVBufferAccIdx = (int)dstModel.accessors.size() - 1;
-        acc.bufferView = (int)dstModel.bufferViews.size() - 1;
-        acc.byteOffset = 0;
-        acc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-        acc.type = TINYGLTF_TYPE_VEC2;
-        acc.count = swbfUVBufferCount;
-    }
-    {
-        copyBuffer(swbfIndexBuffer, swbfIndexBufferCount, segmBuffer, offset);
-        tinygltf::BufferView& view = dstModel.bufferViews.emplace_back();
-        view.buffer = segmBufferIdx;
-        view.byteOffset = offset;
-        view.byteLength = swbfIndexBufferSize;
-        view.byteStride = sizeof(uint16_t);
-        offset += swbfIndexBufferSize;
-        tinygltf::Accessor& acc = dstModel.accessors.emplace_back();
-        gltfIndexBufferAccIdx = (int)dstModel.accessors.size() - 1;
-        acc.bufferView = (int)dstModel.bufferViews.size() - 1;
-        acc.byteOffset = 0;
-        acc.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
-        acc.type = TINYGLTF_TYPE_SCALAR;
-        acc.count = swbfIndexBufferCount;
+    std::vector<std::string> args;
+    auto addOption = [&args](const char* name, const auto& value)
+    {
+        args.push_back(fmt::format("--{0}={1}", name, value));
+    };
+    auto addFlag = [&args](const char* name, bool bSet)
+    {
+        if (bSet)
+        {
+            args.push_back(fmt::format("--{0}", name));
+        }
+    };
+
+    const TextureStageOptions& tex = options.textures;
+    if (!fileCom.empty())
+    {
+        addOption("incommon", fileCom);
+    }
+    addOption("gltf", options.bGLTF ? "true" : "false");
+    addFlag("atlas", tex.bAtlas);
+    addOption("atlas-max", tex.atlasMaxSize);
+    addOption("atlas-size", tex.atlasPageSize);
+    if (!tex.cacheDir.empty())
+    {
+        addOption("cache-dir", tex.cacheDir);
+    }
+    addFlag("stb-png", !tex.bFastPNG);
+    addOption("texture-budget", textureBudgetMB);
+    addFlag("bake-terrain", options.bake.bEnabled);
+    addOption("terrain-tiles", options.bake.tilesPerSide);
+    addOption("terrain-tile-res", options.bake.tileResolution);
+    addOption("threads", numThreads > 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency() / numWorkers));
+    addFlag("split-layers", options.bSplitLayers);
+    addFlag("shared-models", options.bSharedModels);
+    addOption("write-queue", options.writeQueueBytes / (1024 * 1024));
+    addOption("max-memory", options.maxMemoryBytes / (1024 * 1024));
+    if (!layerPattern.empty())
+    {
+        addOption("layers", layerPattern);
+    }
+    addFlag("all-layers", bAllLayers);
+    addFlag("low-memory", options.bLowMemory);
+    if (!parseCacheDir.empty())
+    {
+        addOption("parse-cache", parseCacheDir);
     }
+    return args;
 }
 
-int gltfTopology(ETopology topology)
+// Like convertBatch(), but with 'numWorkers' worker processes converting the LVLs, see Coordinator.h
+int convertWithWorkers(
+    const std::vector<std::string>& filesIn,
+    const std::string& outDir,
+    uint32_t numWorkers,
+    const std::vector<std::string>& workerArgs,
+    const ConvertOptions& options
+)
 {
-    switch (topology)
-    {
-        case ETopology::LineList:
-            return TINYGLTF_MODE_LINE_LOOP;
-        case ETopology::LineStrip:
-            return TINYGLTF_MODE_LINE_STRIP;
-        case ETopology::PointList:
-            return TINYGLTF_MODE_POINTS;
-        case ETopology::TriangleFan:
-            return TINYGLTF_MODE_TRIANGLE_FAN;
-        case ETopology::TriangleList:
-            return TINYGLTF_MODE_TRIANGLES;
-        case ETopology::TriangleStrip:
-            return TINYGLTF_MODE_TRIANGLE_STRIP;
-        default:
-            LOG("Unknown ETopology type: {0}! Assuming Triangle List!", (int)topology);
-            return TINYGLTF_MODE_TRIANGLES;
+    if (!createOutputDir(outDir))
+    {
+        return 1;
+    }
+
+    std::vector<std::string> filesOut;
+    for (const std::string& fileIn : filesIn)
+    {
+        filesOut.push_back(getBatchOutput(fileIn, outDir, options));
     }
+
+    BatchCoordinator coordinator(workerArgs, numWorkers, options.cancelled);
+    return coordinator.Run(filesIn, filesOut) > 0 ? 1 : 0;
 }
 
-void printMenu(const std::vector<std::string>& worldNames, std::vector<bool>& chosenWorlds)
+// Waits for a change of any watched file, then until there were no more changes for a moment,
+// since munging writes a LVL in several steps. Puts the files which changed into 'outChanged'.
+// Returns false if cancelled while waiting or if watching failed.
+bool waitForChanges(FileWatcher& watcher, std::vector<std::string>& outChanged)
 {
-    LOG("Choose which Layers to convert:");
-    for (size_t i = 0; i < worldNames.size(); ++i)
+    constexpr uint32_t QUIET_PERIOD_MS = 500;
+    EWatchResult result;
+    while ((result = watcher.Wait(QUIET_PERIOD_MS, outChanged)) != EWatchResult::Changed)
     {
-        LOG("  {0:2d}) [{1}] {2}", i + 1, chosenWorlds[i] ? 'X' : ' ', worldNames[i]);
+        if (s_bCancelled)
+        {
+            return false;
+        }
+        if (result == EWatchResult::Failed)
+        {
+            LOG("Watching for changes failed!");
+            return false;
+        }
     }
-    LOG("\n  {0:2d}) Select all", worldNames.size() + 1);
-    LOG("  {0:2d}) Remove all", worldNames.size() + 2);
-    LOG("   0) Start conversion");
+    while ((result = watcher.Wait(QUIET_PERIOD_MS, outChanged)) == EWatchResult::Changed)
+    {
+
+    }
+    return result != EWatchResult::Failed;
+}
+
+// Converts 'fileIn' into 'fileOut' again whenever it or 'fileCom' changes, until the process gets killed.
+// The common LVLs stay loaded in between and only get loaded again when they changed themselves.
+// Everything else that didn't change comes from the parse and texture caches.
+int watchLVL(
+    const std::string& fileIn,
+    const std::string& fileCom,
+    const std::string& fileOut,
+    const LayerFilter& isChosen,
+    const std::string& parseCacheDir,
+    const ConvertOptions& options,
+    TaskPool& pool
+)
+{
+    FileWatcher watcher;
+    if (!watcher.Watch(fileIn) || (!fileCom.empty() && !watcher.Watch(fileCom)))
+    {
+        LOG("Could not watch '{0}' for changes!", fileIn.c_str());
+        return 1;
+    }
+
+    ConvertOptions watchOptions = options;
+    watchOptions.onSourcesDone = nullptr;
+
+    LVLContents comContents;
+    Container* con = nullptr;
+    std::unique_ptr<ParseCache> parseCache;
+    auto reloadCommon = [&]()
+    {
+        if (con != nullptr)
+        {
+            con->FreeAll();
+            Container::Delete(con);
+        }
+        comContents = LVLContents();
+        con = loadCommon(fileCom, comContents);
+
+        // the common LVLs are part of every cache key
+        parseCache = std::make_unique<ParseCache>(parseCacheDir, con != nullptr ? fileCom : "");
+        watchOptions.parseCache = parseCache->IsEnabled() ? parseCache.get() : nullptr;
+    };
+    reloadCommon();
+
+    int result = 0;
+    while (true)
+    {
+        LOG("Watching '{0}' for changes, press Ctrl+C to stop...", fileIn.c_str());
+        std::vector<std::string> changed;
+        if (!waitForChanges(watcher, changed))
+        {
+            result = s_bCancelled ? 0 : 1;
+            break;
+        }
+
+        // the world LVL gets converted against the new common LVLs right away, whether it changed as well or not
+        if (!fileCom.empty() && std::find(changed.begin(), changed.end(), fileCom) != changed.end())
+        {
+            LOG("'{0}' changed, loading it again...", fileCom.c_str());
+            reloadCommon();
+        }
+        if (!fs::exists(fileIn))
+        {
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        LOG("Converting '{0}' again...", fileIn.c_str());
+        if (convertStandalone(fileIn, con, con != nullptr ? &comContents : nullptr, isChosen, watchOptions, pool, fileOut))
+        {
+            std::chrono::duration<float> duration = std::chrono::steady_clock::now() - start;
+            LOG("Done in {0:.1f}s!", duration.count());
+        }
+        grabLibSWBF2Logs();
+
+        // a cancelled conversion only ends the watch if it's cancelled while waiting
+        s_bCancelled = false;
+    }
+
+    if (con != nullptr)
+    {
+        con->FreeAll();
+        Container::Delete(con);
+    }
+    return result;
 }
 
 int main(int argc, char** argv)
 {
     CLI::App app{ "LVL to glTF 2.0 converter" };
-    std::string fileIn = "";
+    std::vector<std::string> filesIn;
+    std::string manifest = "";
     std::string fileCom = "";
     std::string fileOut = "";
     bool bGLTF = false;
-    app.add_option("-i,--inlvl", fileIn, "Path to the world LVL file to convert");
+    TextureStageOptions texOptions;
+    TerrainBakeOptions bakeOptions;
+    uint32_t textureBudgetMB = 0;
+    bool stbPNG = false;
+    bool noPipeline = false;
+    uint32_t numThreads = 0;
+    bool bSplitLayers = false;
+    bool bSharedModels = false;
+    uint32_t writeQueueMB = 64;
+    uint32_t maxMemoryMB = 0;
+    uint32_t numParallelLVLs = 0;
+    uint32_t maxRamMB = 0;
+    uint32_t numWorkers = 0;
+    std::string daemonSocket = "";
+    std::string layerPattern = "";
+    bool bAllLayers = false;
+    bool bListLayers = false;
+    bool bLowMemory = false;
+    std::string parseCacheDir = "";
+    bool bWatch = false;
+    std::string journalPath = "";
+    bool bResume = false;
+    app.add_option("-i,--inlvl", filesIn, "Path to the world LVL file to convert. Multiple files are converted in batch mode.");
     app.add_option("-c,--incommon", fileCom, "(optional) Path to ingame.lvl (needed for command posts, turrets, health droids, etc.");
-    app.add_option("-o,--outglb", fileOut, "(optional) output file. If not specified, the output file path will match the input file path, with just the file extension changed.");
+    app.add_option("-o,--outglb", fileOut, "(optional) output file. If not specified, the output file path will match the input file path, with just the file extension changed. In batch mode, this is the output directory.");
     app.add_option("--gltf", bGLTF, "The output file will be a .gltf file (text format). Default is .glb (binary format). Note that for the .gltf format, textures won't get exported!");
+    app.add_flag("--atlas", texOptions.bAtlas, "Pack small textures into shared atlas textures. Reduces the number of materials and draw calls.");
+    app.add_option("--atlas-max", texOptions.atlasMaxSize, "(optional) Textures with width and height up to this size get packed into atlases. Default is 128.");
+    app.add_option("--atlas-size", texOptions.atlasPageSize, "(optional) Width and height of a single atlas texture. Default is 2048.");
+    app.add_option("--cache-dir", texOptions.cacheDir, "(optional) Directory to cache encoded textures in. Subsequent runs on the same or related LVLs reuse them instead of encoding again.");
+    app.add_flag("--stb-png", stbPNG, "Encode textures with stb_image_write instead of the fast parallel PNG encoder. Gives slightly smaller files, but is several times slower.");
+    app.add_option("--texture-budget", textureBudgetMB, "(optional) Maximum size in MB of all decoded textures. Top mip levels of the largest and least used textures get dropped until the export fits. With --split-layers, every file written gets an equal share.");
+    app.add_flag("--no-pipeline", noPipeline, "Wait until all LVLs are loaded before starting the conversion. By default, converting the world LVL already starts while ingame.lvl is still loading.");
+    app.add_flag("--bake-terrain", bakeOptions.bEnabled, "Bake the blended terrain texture layers into one texture per terrain tile.");
+    app.add_option("--terrain-tiles", bakeOptions.tilesPerSide, "(optional) Number of terrain tiles per side when baking. Default is 4.");
+    app.add_option("--terrain-tile-res", bakeOptions.tileResolution, "(optional) Texture resolution of a single baked terrain tile. Default is 1024.");
+    app.add_option("--threads", numThreads, "(optional) Number of worker threads for converting models. Default is 0, which uses all hardware threads.");
+    app.add_flag("--split-layers", bSplitLayers, "Write each chosen layer into its own output file, named after the output file and the layer. Layers get converted and written concurrently.");
+    app.add_flag("--shared-models", bSharedModels, "With --split-layers, models used by more than one layer go into a common '_shared' file instead of being duplicated into every layer file. Instances reference them via the 'sharedFile' and 'sharedMesh' node extras.");
+    app.add_option("--write-queue", writeQueueMB, "(optional) Maximum size in MB of converted data waiting to be written to disk. Conversion pauses when the writer thread falls behind. Default is 64.");
+    app.add_option("--max-memory", maxMemoryMB, "(optional) Maximum size in MB of converted binary data (vertices, indices, images) kept in memory per output file. Anything beyond gets spilled into a temporary file next to the output, which for .gltf outputs becomes an external .bin file. By default, .glb outputs spill everything and .gltf outputs nothing.");
+    app.add_option("--manifest", manifest, "(optional) Text file listing world LVL files to convert in batch mode, one per line.");
+    app.add_option("--parallel-lvls", numParallelLVLs, "(optional) In batch mode, number of world LVLs to convert at the same time. Default is 1, or with --max-ram one per hardware thread.");
+    app.add_option("--max-ram", maxRamMB, "(optional) In batch mode, maximum memory in MB for all LVLs converted at the same time. Every LVL's peak memory gets estimated from its size, and LVLs only start while they fit. Small LVLs get packed around the big ones.");
+    app.add_option("--workers", numWorkers, "(optional) In batch mode, convert the LVLs with this many worker processes instead of threads of this process. Every worker loads the --incommon LVL on its own, and a worker crashing on a broken LVL only fails that LVL.");
+    app.add_option("--daemon", daemonSocket, "(optional) Run as a daemon, accepting conversion jobs as JSON lines on this local socket path. The --incommon LVL stays loaded between jobs.");
+    app.add_option("--layers", layerPattern, "(optional) Convert all layers whose name matches this regular expression (case insensitive, e.g. \"conquest|ctf\") instead of choosing them in the menu. Use ^ and $ to match whole names.");
+    app.add_flag("--all-layers", bAllLayers, "Convert all layers instead of choosing them in the menu.");
+    app.add_flag("--list-layers", bListLayers, "Print the layers of the input LVLs and their instance counts as JSON and exit, without converting anything.");
+    app.add_flag("--low-memory", bLowMemory, "Lower the peak memory usage at the cost of some speed: models get converted in small batches, split layers one after another, and the LVL data is freed before writing the output.");
+    app.add_option("--parse-cache", parseCacheDir, "(optional) Directory to cache the parsed LVL data in. Converting the same LVLs again, e.g. with other options, then skips loading them with LibSWBF2.");
+    app.add_flag("--watch", bWatch, "After converting a single LVL, keep running and convert it again whenever it or the --incommon LVL changes, with the same layers. Unless given, --parse-cache and --cache-dir use directories in the temp directory, so only what changed gets loaded and encoded again.");
+    app.add_option("--journal", journalPath, "(optional) File to record every finished output file in, so an interrupted conversion (e.g. by Ctrl+C) can continue with --resume.");
+    app.add_flag("--resume", bResume, "Skip the output files which the --journal records as finished, as long as the input LVLs, the options and the output files didn't change since.");
     CLI11_PARSE(app, argc, argv);
 
-    if (fileIn.empty())
+    if (bWatch)
+    {
+        // warm caches are what makes converting again fast
+        std::error_code err;
+        const fs::path cacheRoot = fs::temp_directory_path(err) / "LVL2glTF";
+        if (parseCacheDir.empty() && !err)
+        {
+            parseCacheDir = (cacheRoot / "parse").u8string();
+        }
+        if (texOptions.cacheDir.empty() && !err && !bGLTF)
+        {
+            texOptions.cacheDir = (cacheRoot / "textures").u8string();
+        }
+    }
+
+    texOptions.bTextures = !bGLTF;
+    texOptions.bFastPNG = !stbPNG;
+    texOptions.budgetBytes = (uint64_t)textureBudgetMB * 1024 * 1024;
+    const uint64_t writeQueueBytes = (uint64_t)writeQueueMB * 1024 * 1024;
+    if (bakeOptions.bEnabled && texOptions.budgetBytes > 0 && bakedTerrainBytes(bakeOptions) >= texOptions.budgetBytes)
+    {
+        // every baked terrain takes its share off the budget, see convertLayers()
+        LOG("The baked tiles of a single terrain ({0} MB) don't fit into the --texture-budget of {1} MB! Raise the budget or lower --terrain-tiles / --terrain-tile-res.",
+            bakedTerrainBytes(bakeOptions) / (1024 * 1024), textureBudgetMB);
+        return 1;
+    }
+
+    ConvertOptions options;
+    options.textures = texOptions;
+    options.bake = bakeOptions;
+    options.bGLTF = bGLTF;
+    options.bSplitLayers = bSplitLayers;
+    options.bSharedModels = bSharedModels;
+    options.writeQueueBytes = writeQueueBytes;
+    options.bLowMemory = bLowMemory;
+    options.maxMemoryBytes = (uint64_t)maxMemoryMB * 1024 * 1024;
+
+    ParseCache parseCache(parseCacheDir, fs::exists(fileCom) ? fileCom : "");
+    options.parseCache = parseCache.IsEnabled() ? &parseCache : nullptr;
+
+    // without a layer selection on the command line, the interactive menu asks for one
+    std::regex layerRegex;
+    LayerFilter isChosen;
+    if (!layerPattern.empty())
+    {
+        try
+        {
+            layerRegex = std::regex(layerPattern, std::regex::ECMAScript | std::regex::icase);
+        }
+        catch (const std::regex_error& e)
+        {
+            LOG("'{0}' is not a valid regular expression: {1}", layerPattern.c_str(), e.what());
+            return 1;
+        }
+        isChosen = [&layerRegex](const std::string& layerName)
+        {
+            return std::regex_search(layerName, layerRegex);
+        };
+    }
+    else if (bAllLayers)
+    {
+        isChosen = [](const std::string&) { return true; };
+    }
+
+    Logger::SetLogfileLevel(ELogType::Error);
+
+    // stop cleanly instead of dying somewhere in the middle of writing. Daemons too, they're the workers of --workers
+    std::signal(SIGINT, onCancelSignal);
+    std::signal(SIGTERM, onCancelSignal);
+    options.cancelled = &s_bCancelled;
+
+    if (!daemonSocket.empty())
+    {
+        TaskPool pool(numThreads);
+        LVLContents comContents;
+        Container* con = loadCommon(fileCom, comContents);
+        bool bRan = ConversionDaemon(con, con != nullptr ? &comContents : nullptr, options, isChosen, pool).Run(daemonSocket);
+        if (con != nullptr)
+        {
+            con->FreeAll();
+            Container::Delete(con);
+        }
+        logPeakMemory();
+        return bRan ? 0 : 1;
+    }
+
+    if (!manifest.empty() && !readManifest(manifest, filesIn))
+    {
+        return 1;
+    }
+
+    ConversionJournal journal;
+    if (numWorkers > 0 && !journalPath.empty())
+    {
+        // the workers would all write into the same journal
+        LOG("--journal doesn't work together with --workers!");
+        return 1;
+    }
+    if (bResume && journalPath.empty())
+    {
+        LOG("--resume needs a --journal to resume from!");
+        return 1;
+    }
+    if (!journalPath.empty())
+    {
+        if (!journal.Open(journalPath, bResume))
+        {
+            return 1;
+        }
+        options.journal = &journal;
+        options.journalKey = hashOutputSettings(options, fileCom, layerPattern, bAllLayers);
+    }
+
+    if (filesIn.empty())
     {
         LOG("No input LVL file specified!");
         LOG(app.help());
         return 1;
     }
 
+    if (bListLayers)
+    {
+        return listLayers(filesIn);
+    }
+
+    if (bWatch && (filesIn.size() > 1 || !manifest.empty()))
+    {
+        LOG("--watch only works with a single input LVL!");
+        return 1;
+    }
+
+    if (numWorkers > 0 && filesIn.size() == 1 && manifest.empty())
+    {
+        LOG("--workers only works in batch mode, with several input LVLs or a --manifest!");
+        return 1;
+    }
+
+    if (numWorkers > 0)
+    {
+        return convertWithWorkers(filesIn, fileOut, numWorkers, getWorkerArgs(options, fileCom, textureBudgetMB, layerPattern, bAllLayers, parseCacheDir, numWorkers, numThreads), options);
+    }
+
+    if (filesIn.size() > 1 || !manifest.empty())
+    {
+        TaskPool pool(numThreads);
+        if (numParallelLVLs == 0)
+        {
+            numParallelLVLs = maxRamMB > 0 ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+        }
+        int result = convertBatch(filesIn, fileCom, fileOut, isChosen, numParallelLVLs, (uint64_t)maxRamMB * 1024 * 1024, options, pool);
+        logPeakMemory();
+        return result;
+    }
+
+    const std::string fileIn = filesIn[0];
     if (!fs::exists(fileIn))
     {
         LOG("Specified file '{0}' doesn't exist!", fileIn.c_str());
@@ -251,75 +763,108 @@ int main(int argc, char** argv)
         p.replace_extension(bGLTF ? ".gltf" : ".glb");
         fileOut = p.u8string();
     }
-    
-    Logger::SetLogfileLevel(ELogType::Error);
 
-    Container* con = Container::Create();
-    con->AddLevel(fileIn.c_str());
-    if (!fileCom.empty())
+    // The world LVL usually finishes loading long before ingame.lvl does. Unless
+    // some stage needs to see all models and textures upfront, start the conversion
+    // right after the world LVL, and only wait for the rest when needed.
+    const bool bPipelined = !noPipeline && !texOptions.bAtlas && texOptions.budgetBytes == 0 && !bakeOptions.bEnabled && !bSplitLayers;
+
+    // the layer menu only needs the chunk headers, so it shows up right away
+    const std::string filename = fs::path(fileIn).filename().u8string();
+    LVLContents contents;
+    if (!scanLVL(fileIn, contents))
     {
-        if (fs::exists(fileCom))
-        {
-            con->AddLevel(fileCom.c_str());
-        }
-        else
+        return 1;
+    }
+    if (contents.m_Layers.empty())
+    {
+        LOG("Seems like '{0}' doesn't contain any world data! Nothing to do...", filename.c_str());
+        return 1;
+    }
+
+    // with a parse cache hit, nothing has to be loaded at all
+    std::unique_ptr<SourceScene> scene;
+    uint64_t cacheKey = 0;
+    if (options.parseCache != nullptr)
+    {
+        cacheKey = parseCache.GetKey(fileIn);
+        scene = parseCache.Load(cacheKey, texOptions.bTextures);
+        if (scene != nullptr)
         {
-            LOG("Could not find '{0}'!", fileCom.c_str());
+            LOG("Read '{0}' from the parse cache.", filename.c_str());
         }
     }
-    con->StartLoading();
 
-    std::string filename = fs::path(fileIn).filename().u8string();
-    char updateLine[80] = {' '};
-    fmt::format_to(updateLine, "Start Loading '{0}'...", filename.c_str());
-    updateLine[79] = 0;
-    std::cout << updateLine;
+    // LibSWBF2 only reads LVLs by path. So at least let the OS pull the world LVL into
+    // the page cache while the layers get chosen, instead of waiting for the disk afterwards.
+    MappedFile worldView;
+    if (scene == nullptr && worldView.Open(fileIn))
+    {
+        worldView.Prefetch();
+    }
 
-    while (!con->IsDone())
+    // while choosing, ingame.lvl can already load
+    Container* con = nullptr;
+    LVLContents comContents;
+    std::string comName;
+    if (scene == nullptr && !fileCom.empty())
     {
-        if (grabLibSWBF2Logs())
+        if (fs::exists(fileCom))
         {
-            LOG("Loading '{0}'... {1}%", fileIn.c_str(), (int)(con->GetOverallProgress() * 100.0f));
+            scanLVL(fileCom, comContents);
+            comName = fs::path(fileCom).filename().u8string();
+            LOG("Start Loading '{0}'...", comName.c_str());
+            con = Container::Create();
+            con->AddLevel(fileCom.c_str());
+            con->StartLoading();
         }
         else
         {
-            std::memset(updateLine, ' ', 80);
-            fmt::format_to(updateLine, "Loading '{0}'... {1}%", filename.c_str(), (int)(con->GetOverallProgress() * 100.0f));
-            updateLine[79] = 0;
-            std::cout << '\r' << updateLine;
+            LOG("Could not find '{0}'!", fileCom.c_str());
         }
     }
-    LOG("");
-
-    Level* lvl = con->TryGetWorldLevel();
-    if (lvl == nullptr)
+    auto freeCommon = [&]()
     {
-        LOG("Loading '{0}' failed!", filename.c_str());
-        return 1;
-    }
+        if (con != nullptr)
+        {
+            // make sure the loader threads are finished before freeing anything
+            waitForLoading(con, comName, []() { return false; });
+            con->FreeAll();
+            Container::Delete(con);
+            con = nullptr;
+        }
+        grabLibSWBF2Logs();
+    };
 
-    const List<World> worlds = lvl->GetWorlds();
-    if (worlds.Size() == 0)
+    std::vector<std::string> worldNames;
+    std::vector<bool> chosenWorlds;
+    uint32_t numChosen = 0;
+    for (const LayerInfo& layer : contents.m_Layers)
     {
-        LOG("Seems like '{0}' doesn't contain any world data! Nothing to do...", filename.c_str());
-        return 1;
+        worldNames.emplace_back(fmt::format("{0:25s} [{1} objects]", layer.m_Name.c_str(), layer.m_NumInstances));
+        chosenWorlds.emplace_back(isChosen && isChosen(layer.m_Name));
+        numChosen += chosenWorlds.back() ? 1 : 0;
     }
 
-    std::vector<std::string> worldNames;
-    std::vector<bool> chosenWorlds;
-    for (uint32_t i = 0; i < worlds.Size(); ++i)
+    if (isChosen && numChosen == 0)
     {
-        worldNames.emplace_back(fmt::format("{0:25s} [{1} objects]", worlds[i].GetName().Buffer(), worlds[i].GetInstances().Size()));
-        chosenWorlds.emplace_back(false);
+        LOG("None of the layers in '{0}' matches '{1}'!", filename.c_str(), layerPattern.c_str());
+        freeCommon();
+        return 1;
     }
 
     int option = -1;
     int numLayers = 0;
-    do
+    while (!isChosen && (option != 0 || numLayers == 0))
     {
         printMenu(worldNames, chosenWorlds);
         std::cout << "\nChoose: ";
         std::cin >> option;
+        if (s_bCancelled)
+        {
+            freeCommon();
+            return 1;
+        }
         if (std::cin.fail())
         {
             LOG("Given input was not a valid number!");
@@ -342,6 +887,7 @@ int main(int argc, char** argv)
                 {
                     chosenWorlds[i] = true;
                 }
+                numLayers = (int)chosenWorlds.size();
             }
             else if (option == worldNames.size() + 2)
             {
@@ -349,6 +895,7 @@ int main(int argc, char** argv)
                 {
                     chosenWorlds[i] = false;
                 }
+                numLayers = 0;
             }
             else
             {
@@ -361,213 +908,137 @@ int main(int argc, char** argv)
             LOG("No layers choosen for conversion! Choose at least one layer!");
         }
     }
-    while (option != 0 || numLayers == 0);
-
-    tinygltf::Model gltf;
-    gltf.asset.copyright = "https://github.com/Ben1138/LVL2glTF";
-    gltf.asset.generator = "LVL2glTF converter";
-    gltf.asset.minVersion = "2.0";
-    gltf.asset.version = "2.0";
-
-    std::unordered_map<std::string, int> geomNameToMeshIdx;
-
-    for (uint32_t i = 0; i < worlds.Size(); ++i)
-    {
-        // skip unwanted layers
-        if (!chosenWorlds[i]) continue;
-
-        const World& wld = worlds[i];
-        String wldName = wld.GetName();
-        const Terrain* terr = wld.GetTerrain();
-
-        tinygltf::Scene& scene = gltf.scenes.emplace_back();
-        scene.name = wldName.Buffer();
-        
-        if (terr != nullptr)
-        {
-            tinygltf::Node& terrNode = gltf.nodes.emplace_back();
-            terrNode.name = terr->GetName().Buffer();
-            scene.nodes.emplace_back((int)gltf.nodes.size() - 1);
-            terrNode.translation = { 0.0, 0.0, 0.0 };
-            terrNode.rotation = { 0.0, 0.0, 0.0, 1.0 };
-
-            tinygltf::Mesh& terrMesh = gltf.meshes.emplace_back();
-            int terrMeshIdx = (int)gltf.meshes.size() - 1;
-            terrMesh.name = terr->GetName().Buffer();
-            terrNode.mesh = terrMeshIdx;
-
-            Vector3*  swbfVertexBuffer = nullptr;
-            uint32_t  swbfVertexBufferCount = 0;
-            Vector3*  swbfNormalBuffer = nullptr;
-            uint32_t  swbfNormalBufferCount = 0;
-            Vector2*  swbfUVBuffer = nullptr;
-            uint32_t  swbfUVBufferCount = 0;
-            uint16_t* swbfIndexBuffer = nullptr;
-            uint32_t  swbfIndexBufferCount = 0;
-            int gltfVertexBufferAccIdx = 0;
-            int gltfNormalBufferAccIdx = 0;
-            int gltfUVBufferAccIdx = 0;
-            int gltfIndexBufferAccIdx = 0;
-
-            terr->GetVertexBuffer(swbfVertexBufferCount, swbfVertexBuffer);
-            terr->GetNormalBuffer(swbfNormalBufferCount, swbfNormalBuffer);
-            terr->GetUVBuffer(swbfUVBufferCount, swbfUVBuffer);
-            terr->GetIndexBuffer(ETopology::TriangleList, swbfIndexBufferCount, swbfIndexBuffer);
-
-            copyBuffers(
-                swbfVertexBuffer,
-                swbfVertexBufferCount,
-                swbfNormalBuffer,
-                swbfNormalBufferCount,
-                swbfUVBuffer,
-                swbfUVBufferCount,
-                swbfIndexBuffer,
-                swbfIndexBufferCount,
-                gltf,
-                gltfVertexBufferAccIdx,
-                gltfNormalBufferAccIdx,
-                gltfUVBufferAccIdx,
-                gltfIndexBufferAccIdx
-            );
-
-            // TODO: prevent material duplicates
-            tinygltf::Material& gltfMat = gltf.materials.emplace_back();
-            gltfMat.pbrMetallicRoughness.baseColorFactor = { 1.0, 1.0, 1.0, 1.0 };
-            gltfMat.pbrMetallicRoughness.metallicFactor = 0.0f;
-
-            // TODO: textures
-
-            tinygltf::Primitive& prim = terrMesh.primitives.emplace_back();
-            prim.attributes =
-            {
-                { "POSITION",   gltfVertexBufferAccIdx },
-                { "NORMAL",     gltfNormalBufferAccIdx },
-                { "TEXCOORD_0", gltfUVBufferAccIdx     },
-            };
 
-            prim.indices = gltfIndexBufferAccIdx;
-            prim.mode = TINYGLTF_MODE_TRIANGLES;
-            prim.material = (int)gltf.materials.size() - 1;
+
+    Level* lvl = nullptr;
+    std::function<void()> waitForRest;
+    if (scene == nullptr)
+    {
+        LOG("Start Loading '{0}'...", filename.c_str());
+
+        // a cache entry has to serve any layer selection
+        const std::vector<bool> layersToLoad = options.parseCache != nullptr ? std::vector<bool>(chosenWorlds.size(), true) : chosenWorlds;
+        // models which didn't change since they got cached don't have to be loaded again
+        std::unordered_map<std::string, uint64_t> modelHashes;
+        std::unordered_set<std::string> cachedNames;
+        std::unique_ptr<SourceScene> cachedModels;
+        if (options.parseCache != nullptr && hashModels(fileIn, modelHashes))
+        {
+            cachedModels = parseCache.LoadModels(modelHashes, cachedNames);
+        }
+        lvl = loadLayers(fileIn, contents, layersToLoad, con != nullptr ? &comContents : nullptr, &cachedNames);
+        worldView.Close();
+        grabLibSWBF2Logs();
+        if (lvl == nullptr)
+        {
+            LOG("Loading '{0}' failed!", filename.c_str());
+            freeCommon();
+            return 1;
         }
 
-        List<Instance> insts = wld.GetInstances();
-        for (uint32_t j = 0; j < insts.Size(); ++j)
+        // a cache entry has to be complete, so it can't be stored before everything is loaded
+        if (con != nullptr && (!bPipelined || options.parseCache != nullptr))
         {
-            const Instance& inst = insts[j];
-            String instName = inst.GetName();
+            waitForLoading(con, comName, []() { return false; });
+        }
+        scene = std::make_unique<SourceScene>(lvl, con, std::move(cachedModels));
+        if (options.parseCache != nullptr)
+        {
+            parseCache.StoreModels(modelHashes, *scene);
+        }
 
-            String geometryName;
-            if (!inst.GetProperty("GeometryName", geometryName))
+        // convert from the freshly stored entry, so the LVLs don't have to stay loaded
+        std::unique_ptr<SourceScene> cached;
+        if (options.parseCache != nullptr && parseCache.Store(cacheKey, *scene, texOptions.bTextures))
+        {
+            cached = parseCache.Load(cacheKey, texOptions.bTextures);
+        }
+        if (cached != nullptr)
+        {
+            scene = std::move(cached);
+            Level::Destroy(lvl);
+            lvl = nullptr;
+            freeCommon();
+        }
+
+        // the output doesn't depend on this, world models always come first (see convertLayers())
+        if (con != nullptr && !con->IsDone())
+        {
+            waitForRest = [con, &comName]()
             {
-                //LOG("Could not resolve 'GeometryName' property of instance '{0}' in world '{1}'", instName.Buffer(), wldName.Buffer());
-                continue;
-            }
-            
-            const Model* model = con->FindModel(geometryName);
-            if (model == nullptr)
+                LOG("Waiting for remaining LVLs to finish loading...");
+                waitForLoading(con, comName, []() { return false; });
+            };
+        }
+    }
+
+    TaskPool pool(numThreads);
+
+    if (bLowMemory)
+    {
+        options.onSourcesDone = [&]()
+        {
+            const uint64_t before = getResidentMemory();
+            if (lvl != nullptr)
             {
-                //LOG("Could not find model '{0}' for instance '{1}'!", geometryName.Buffer(), instName.Buffer());
-                continue;
+                Level::Destroy(lvl);
+                lvl = nullptr;
             }
+            freeCommon();
+            LOG("Freed the LVL data, resident memory went from {0} MB down to {1} MB.", before / (1024 * 1024), getResidentMemory() / (1024 * 1024));
+        };
+    }
 
-            tinygltf::Node& node = gltf.nodes.emplace_back();
-            node.name = instName.Buffer();
-            scene.nodes.emplace_back((int)gltf.nodes.size() - 1);
+    if (options.journal != nullptr)
+    {
+        // layers chosen in the menu aren't part of the settings
+        Hasher journalKey(options.journalKey);
+        journalKey.Add(ConversionJournal::StampFile(fileIn));
+        for (size_t i = 0; i < contents.m_Layers.size(); ++i)
+        {
+            journalKey.Add(chosenWorlds[i] ? contents.m_Layers[i].m_Name : "");
+        }
+        options.journalKey = journalKey.Get();
+    }
 
-            Vector3 pos = inst.GetPosition();
-            Vector4 rot = inst.GetRotation();
-            node.translation = { pos.m_X, pos.m_Y, pos.m_Z };
-            node.rotation = { rot.m_X, rot.m_Y, rot.m_Z, rot.m_W };
+    bool bSuccess = convertWorld(*scene, waitForRest, matchLoadedLayers(contents, chosenWorlds, scene->GetLayers()), options, pool, fileOut);
 
-            // check whether the referenced mesh was already converted
-            auto it = geomNameToMeshIdx.find(geometryName.Buffer());
-            if (it != geomNameToMeshIdx.end())
-            {
-                node.mesh = it->second;
-            }
-            else
-            {
-                tinygltf::Mesh& mesh = gltf.meshes.emplace_back();
-                int meshIdx = (int)gltf.meshes.size() - 1;
-                geomNameToMeshIdx.emplace(geometryName.Buffer(), meshIdx);
-                mesh.name = model->GetName().Buffer();
-                node.mesh = meshIdx;
+    if (lvl != nullptr)
+    {
+        Level::Destroy(lvl);
+        lvl = nullptr;
+    }
+    freeCommon();
+    logPeakMemory();
 
-                LOG("Converting mesh '{0}'", mesh.name.c_str());
+    if (s_bCancelled)
+    {
+        LOG("Cancelled.");
+        return 1;
+    }
 
-                const List<Segment>& segments = model->GetSegments();
-                for (uint32_t k = 0; k < segments.Size(); ++k)
-                {
-                    const Segment& segm = segments[k];
-
-                    Vector3*  swbfVertexBuffer = nullptr;
-                    uint32_t  swbfVertexBufferCount = 0;
-                    Vector3*  swbfNormalBuffer = nullptr;
-                    uint32_t  swbfNormalBufferCount = 0;
-                    Vector2*  swbfUVBuffer = nullptr;
-                    uint32_t  swbfUVBufferCount = 0;
-                    uint16_t* swbfIndexBuffer = nullptr;
-                    uint32_t  swbfIndexBufferCount = 0;
-                    int gltfVertexBufferAccIdx = 0;
-                    int gltfNormalBufferAccIdx = 0;
-                    int gltfUVBufferAccIdx = 0;
-                    int gltfIndexBufferAccIdx = 0;
-
-                    segm.GetVertexBuffer(swbfVertexBufferCount, swbfVertexBuffer);
-                    segm.GetNormalBuffer(swbfNormalBufferCount, swbfNormalBuffer);
-                    segm.GetUVBuffer(swbfUVBufferCount, swbfUVBuffer);
-                    segm.GetIndexBuffer(swbfIndexBufferCount, swbfIndexBuffer);
-
-                    copyBuffers(
-                        swbfVertexBuffer,
-                        swbfVertexBufferCount,
-                        swbfNormalBuffer,
-                        swbfNormalBufferCount,
-                        swbfUVBuffer,
-                        swbfUVBufferCount,
-                        swbfIndexBuffer,
-                        swbfIndexBufferCount,
-                        gltf,
-                        gltfVertexBufferAccIdx,
-                        gltfNormalBufferAccIdx,
-                        gltfUVBufferAccIdx,
-                        gltfIndexBufferAccIdx
-                    );
-
-                    // TODO: prevent material duplicates
-                    const Material& swbfMat = segm.GetMaterial();
-                    tinygltf::Material& gltfMat = gltf.materials.emplace_back();
-                    convertColor(swbfMat.GetDiffuseColor(), gltfMat.pbrMetallicRoughness.baseColorFactor);
-                    gltfMat.pbrMetallicRoughness.metallicFactor = 0.0f;
-                    
-                    // TODO: textures
-                    
-
-                    tinygltf::Primitive& prim = mesh.primitives.emplace_back();
-                    prim.attributes =
-                    { 
-                        { "POSITION",   gltfVertexBufferAccIdx },
-                        { "NORMAL",     gltfNormalBufferAccIdx },
-                        { "TEXCOORD_0", gltfUVBufferAccIdx     },
-                    };
-
-                    prim.indices = gltfIndexBufferAccIdx;
-                    prim.mode = gltfTopology(segm.GetTopology());
-                    prim.material = (int)gltf.materials.size() - 1;
-                }
+    if (bWatch)
+    {
+        // don't ask again, keep the layers chosen now
+        std::set<std::string> chosenNames;
+        for (size_t i = 0; i < contents.m_Layers.size(); ++i)
+        {
+            if (chosenWorlds[i])
+            {
+                chosenNames.insert(contents.m_Layers[i].m_Name);
             }
         }
+        LayerFilter isChosenAgain = isChosen ? isChosen : [chosenNames](const std::string& layerName)
+        {
+            return chosenNames.count(layerName) > 0;
+        };
+        return watchLVL(fileIn, fileCom, fileOut, isChosenAgain, parseCacheDir, options, pool);
     }
 
-    con->FreeAll();
-    Container::Delete(con);
-
-    grabLibSWBF2Logs();
-
-    LOG("Writing output file: {0}...", fileOut.c_str());
-    tinygltf::TinyGLTF writer;
-    writer.WriteGltfSceneToFile(&gltf, fileOut, false, true, true, !bGLTF);
+    if (!bSuccess)
+    {
+        return 1;
+    }
     LOG("Done!");
-
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,568 @@
+#include "LVLScanner.h"
+#include "Hash.h"
+#include "Platform.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+constexpr size_t CHUNK_HEADER_SIZE = 8;
+
+// a filtered copy only pays off if it's considerably smaller than the original
+constexpr double MAX_FILTERED_RATIO = 0.75;
+
+// guards against cyclic class hierarchies
+constexpr int MAX_CLASS_DEPTH = 32;
+
+
+static uint32_t readUInt32(const uint8_t* data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static std::string readString(const uint8_t* data, size_t size)
+{
+    return std::string((const char*)data, strnlen((const char*)data, size));
+}
+
+static std::string toLower(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(), [](char c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; });
+    return str;
+}
+
+static bool isChunk(const uint8_t* header, const char* name)
+{
+    return std::memcmp(header, name, 4) == 0;
+}
+
+static bool isClassChunk(const uint8_t* header)
+{
+    return isChunk(header, "entc") || isChunk(header, "ordc") || isChunk(header, "wpnc") || isChunk(header, "expc");
+}
+
+static size_t paddedSize(size_t size)
+{
+    return (size + 3) & ~(size_t)3;
+}
+
+// Calls 'visit(header, data, size)' for every chunk between 'begin' and 'end'.
+// Chunks are 4 byte aligned. Returns false on a chunk reaching past 'end'.
+template<class Func>
+static bool forEachChunk(const uint8_t* begin, const uint8_t* end, Func visit)
+{
+    const uint8_t* pos = begin;
+    while ((size_t)(end - pos) >= CHUNK_HEADER_SIZE)
+    {
+        const uint32_t size = readUInt32(pos + 4);
+        const uint8_t* data = pos + CHUNK_HEADER_SIZE;
+        if (size > (size_t)(end - data))
+        {
+            return false;
+        }
+        visit(pos, data, size);
+
+        if (paddedSize(size) >= (size_t)(end - data))
+        {
+            break;
+        }
+        pos = data + paddedSize(size);
+    }
+    return true;
+}
+
+// 'NAME' child chunk of models and textures
+static std::string readChunkName(const uint8_t* data, uint32_t size)
+{
+    std::string name;
+    forEachChunk(data, data + size, [&name](const uint8_t* header, const uint8_t* data, uint32_t size)
+    {
+        if (name.empty() && isChunk(header, "NAME"))
+        {
+            name = readString(data, size);
+        }
+    });
+    return name;
+}
+
+// 'PROP' chunks hold the property name hash, followed by the value string
+static bool readGeometryProperty(const uint8_t* data, uint32_t size, std::string& outGeometry)
+{
+    static const uint32_t GEOMETRY_NAME_HASH = fnvHash("GeometryName");
+    if (size < 4 || readUInt32(data) != GEOMETRY_NAME_HASH)
+    {
+        return false;
+    }
+    outGeometry = readString(data + 4, size - 4);
+    return true;
+}
+
+static bool scanWorld(const uint8_t* data, uint32_t size, LayerInfo& layer)
+{
+    return forEachChunk(data, data + size, [&layer](const uint8_t* header, const uint8_t* data, uint32_t size)
+    {
+        if (isChunk(header, "NAME"))
+        {
+            layer.m_Name = readString(data, size);
+        }
+        else if (isChunk(header, "inst"))
+        {
+            layer.m_NumInstances++;
+            forEachChunk(data, data + size, [&layer](const uint8_t* header, const uint8_t* data, uint32_t size)
+            {
+                std::string geometry;
+                if (isChunk(header, "INFO"))
+                {
+                    forEachChunk(data, data + size, [&layer](const uint8_t* header, const uint8_t* data, uint32_t size)
+                    {
+                        if (isChunk(header, "TYPE"))
+                        {
+                            layer.m_Classes.insert(toLower(readString(data, size)));
+                        }
+                    });
+                }
+                else if (isChunk(header, "PROP") && readGeometryProperty(data, size, geometry))
+                {
+                    layer.m_Geometry.insert(toLower(geometry));
+                }
+            });
+        }
+    });
+}
+
+static void scanClass(const uint8_t* data, uint32_t size, LVLContents& outContents)
+{
+    std::string name;
+    ClassInfo info;
+    forEachChunk(data, data + size, [&](const uint8_t* header, const uint8_t* data, uint32_t size)
+    {
+        std::string geometry;
+        if (isChunk(header, "TYPE"))
+        {
+            name = toLower(readString(data, size));
+        }
+        else if (isChunk(header, "BASE"))
+        {
+            info.m_Base = toLower(readString(data, size));
+        }
+        else if (isChunk(header, "PROP") && info.m_Geometry.empty() && readGeometryProperty(data, size, geometry))
+        {
+            info.m_Geometry = toLower(geometry);
+        }
+    });
+    if (!name.empty())
+    {
+        outContents.m_Classes.emplace(name, std::move(info));
+    }
+}
+
+static void scanModel(const uint8_t* data, uint32_t size, LVLContents& outContents)
+{
+    std::set<std::string>& textures = outContents.m_ModelTextures[toLower(readChunkName(data, size))];
+    forEachChunk(data, data + size, [&textures](const uint8_t* header, const uint8_t* data, uint32_t size)
+    {
+        if (!isChunk(header, "segm"))
+        {
+            return;
+        }
+        forEachChunk(data, data + size, [&textures](const uint8_t* header, const uint8_t* data, uint32_t size)
+        {
+            // texture slot index, followed by the texture name
+            if (isChunk(header, "TNAM") && size > 4)
+            {
+                std::string texture = readString(data + 4, size - 4);
+                if (!texture.empty())
+                {
+                    textures.insert(toLower(texture));
+                }
+            }
+        });
+    });
+}
+
+static bool scanChunks(const uint8_t* begin, const uint8_t* end, uint32_t subLVLHash, LVLContents& outContents)
+{
+    bool bValid = true;
+    bValid &= forEachChunk(begin, end, [&](const uint8_t* header, const uint8_t* data, uint32_t size)
+    {
+        if (isChunk(header, "wrld"))
+        {
+            LayerInfo& layer = outContents.m_Layers.emplace_back();
+            layer.m_SubLVLHash = subLVLHash;
+            bValid &= scanWorld(data, size, layer);
+        }
+        else if (isClassChunk(header))
+        {
+            scanClass(data, size, outContents);
+        }
+        else if (isChunk(header, "modl"))
+        {
+            scanModel(data, size, outContents);
+            outContents.m_ModelBytes += size;
+        }
+        else if (isChunk(header, "tex_"))
+        {
+            outContents.m_TextureBytes += size;
+        }
+        else if (isChunk(header, "lvl_") && size >= 8)
+        {
+            // name hash and the size of the actual content, followed by the sub LVL's chunks
+            const uint32_t hash = readUInt32(data);
+            const uint32_t contentSize = std::min(readUInt32(data + 4), size - 8);
+            outContents.m_SubLVLHashes.insert(hash);
+            bValid &= scanChunks(data + 8, data + 8 + contentSize, hash, outContents);
+        }
+    });
+    return bValid;
+}
+
+// Returns the ucfb root's content, or false if 'file' isn't a LVL
+static bool getRootChunks(const MappedFile& file, const uint8_t*& outBegin, const uint8_t*& outEnd)
+{
+    const uint8_t* data = file.GetData();
+    const size_t size = file.GetSize();
+    if (size < CHUNK_HEADER_SIZE || !isChunk(data, "ucfb"))
+    {
+        return false;
+    }
+    outBegin = data + CHUNK_HEADER_SIZE;
+    outEnd = outBegin + std::min((size_t)readUInt32(data + 4), size - CHUNK_HEADER_SIZE);
+    return true;
+}
+
+bool scanLVL(const std::string& path, LVLContents& outContents)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        LOG("Could not open '{0}'!", path.c_str());
+        return false;
+    }
+
+    const uint8_t* begin;
+    const uint8_t* end;
+    if (!getRootChunks(file, begin, end))
+    {
+        LOG("'{0}' is not a LVL file!", path.c_str());
+        return false;
+    }
+    if (!scanChunks(begin, end, 0, outContents))
+    {
+        LOG("'{0}' seems to be truncated or corrupt!", path.c_str());
+        return false;
+    }
+    outContents.m_FileBytes = file.GetSize();
+    return true;
+}
+
+static void hashModelChunks(const uint8_t* begin, const uint8_t* end, std::unordered_map<std::string, uint64_t>& outHashes)
+{
+    forEachChunk(begin, end, [&](const uint8_t* header, const uint8_t* data, uint32_t size)
+    {
+        if (isChunk(header, "modl"))
+        {
+            outHashes[toLower(readChunkName(data, size))] = Hasher().Add(header, CHUNK_HEADER_SIZE + size).Get();
+        }
+        else if (isChunk(header, "lvl_") && size >= 8)
+        {
+            const uint32_t contentSize = std::min(readUInt32(data + 4), size - 8);
+            hashModelChunks(data + 8, data + 8 + contentSize, outHashes);
+        }
+    });
+}
+
+bool hashModels(const std::string& path, std::unordered_map<std::string, uint64_t>& outHashes)
+{
+    MappedFile file;
+    const uint8_t* begin;
+    const uint8_t* end;
+    if (!file.Open(path) || !getRootChunks(file, begin, end))
+    {
+        return false;
+    }
+    hashModelChunks(begin, end, outHashes);
+    return true;
+}
+
+
+// What to leave out of a filtered copy, all names in lower case
+struct LVLFilter
+{
+    std::unordered_set<std::string> m_DroppedModels;
+    std::unordered_set<std::string> m_DroppedTextures;
+    std::set<uint32_t> m_DroppedSubLVLs;
+};
+
+// Follows the class hierarchy up to the first class setting a geometry. Classes and bases which aren't
+// defined in any of the scanned LVLs are native class labels (e.g. "prop"), or LibSWBF2 won't find them either.
+static std::string resolveGeometry(std::string className, const LVLContents& contents, const LVLContents* common)
+{
+    for (int depth = 0; depth < MAX_CLASS_DEPTH && !className.empty(); ++depth)
+    {
+        auto it = contents.m_Classes.find(className);
+        if (it == contents.m_Classes.end())
+        {
+            if (common == nullptr || (it = common->m_Classes.find(className)) == common->m_Classes.end())
+            {
+                return "";
+            }
+        }
+        if (!it->second.m_Geometry.empty())
+        {
+            return it->second.m_Geometry;
+        }
+        className = it->second.m_Base;
+    }
+    return "";
+}
+
+static LVLFilter buildFilter(
+    const LVLContents& contents,
+    const std::vector<bool>& chosenLayers,
+    const LVLContents* common,
+    const std::unordered_set<std::string>* cachedModels
+)
+{
+    std::unordered_set<std::string> usedModels;
+    std::set<uint32_t> usedSubLVLs;
+    for (size_t i = 0; i < contents.m_Layers.size(); ++i)
+    {
+        const LayerInfo& layer = contents.m_Layers[i];
+        if (!chosenLayers[i])
+        {
+            continue;
+        }
+        usedSubLVLs.insert(layer.m_SubLVLHash);
+        usedModels.insert(layer.m_Geometry.begin(), layer.m_Geometry.end());
+        for (const std::string& className : layer.m_Classes)
+        {
+            usedModels.insert(resolveGeometry(className, contents, common));
+        }
+    }
+
+    LVLFilter filter;
+    for (const LayerInfo& layer : contents.m_Layers)
+    {
+        if (layer.m_SubLVLHash != 0 && usedSubLVLs.count(layer.m_SubLVLHash) == 0)
+        {
+            filter.m_DroppedSubLVLs.insert(layer.m_SubLVLHash);
+        }
+    }
+
+    // textures may be shared with models which are kept, and terrains, skies etc. use textures too
+    std::unordered_set<std::string> keptTextures;
+    for (const auto& [model, textures] : contents.m_ModelTextures)
+    {
+        const bool bUsed = usedModels.count(model) > 0;
+        if (bUsed)
+        {
+            keptTextures.insert(textures.begin(), textures.end());
+        }
+        if (!bUsed || (cachedModels != nullptr && cachedModels->count(model) > 0))
+        {
+            filter.m_DroppedModels.insert(model);
+        }
+    }
+    for (const std::string& model : filter.m_DroppedModels)
+    {
+        for (const std::string& texture : contents.m_ModelTextures.at(model))
+        {
+            if (keptTextures.count(texture) == 0)
+            {
+                filter.m_DroppedTextures.insert(texture);
+            }
+        }
+    }
+    return filter;
+}
+
+// Copies all chunks between 'begin' and 'end' which pass the filter, and returns the number of bytes
+// they take up, including padding. Without 'out', only counts.
+static uint64_t copyChunks(const uint8_t* begin, const uint8_t* end, const LVLFilter& filter, std::ofstream* out)
+{
+    uint64_t written = 0;
+    forEachChunk(begin, end, [&](const uint8_t* header, const uint8_t* data, uint32_t size)
+    {
+        if ((isChunk(header, "modl") && filter.m_DroppedModels.count(toLower(readChunkName(data, size))) > 0) ||
+            (isChunk(header, "tex_") && filter.m_DroppedTextures.count(toLower(readChunkName(data, size))) > 0))
+        {
+            return;
+        }
+
+        if (isChunk(header, "lvl_") && size >= 8)
+        {
+            const uint32_t hash = readUInt32(data);
+            if (filter.m_DroppedSubLVLs.count(hash) > 0)
+            {
+                return;
+            }
+
+            // the sub LVL shrinks as well, so both sizes need patching afterwards
+            const uint32_t contentSize = std::min(readUInt32(data + 4), size - 8);
+            std::streampos headerPos;
+            if (out != nullptr)
+            {
+                headerPos = out->tellp();
+                out->write((const char*)header, CHUNK_HEADER_SIZE + 8);
+            }
+            const uint64_t newContentSize = copyChunks(data + 8, data + 8 + contentSize, filter, out);
+            if (out != nullptr)
+            {
+                const uint32_t sizes[2] = { (uint32_t)(newContentSize + 8), (uint32_t)newContentSize };
+                const std::streampos endPos = out->tellp();
+                out->seekp(headerPos + std::streamoff(4));
+                out->write((const char*)&sizes[0], 4);
+                out->seekp(4, std::ios::cur);
+                out->write((const char*)&sizes[1], 4);
+                out->seekp(endPos);
+            }
+            written += CHUNK_HEADER_SIZE + 8 + newContentSize;
+            return;
+        }
+
+        const size_t chunkSize = CHUNK_HEADER_SIZE + paddedSize(size);
+        if (out != nullptr)
+        {
+            // the padding of the very last chunk might lie beyond the end of the file
+            const size_t available = std::min(chunkSize, (size_t)(end - header));
+            out->write((const char*)header, available);
+            for (size_t i = available; i < chunkSize; ++i)
+            {
+                out->put(0);
+            }
+        }
+        written += chunkSize;
+    });
+    return written;
+}
+
+// Writes the filtered copy of 'path' into the temp directory. Returns an empty
+// path if it's not worth it, because the copy would be almost as large.
+static std::string writeFilteredLVL(
+    const std::string& path,
+    const LVLContents& contents,
+    const std::vector<bool>& chosenLayers,
+    const LVLContents* common,
+    const std::unordered_set<std::string>* cachedModels
+)
+{
+    MappedFile file;
+    const uint8_t* begin;
+    const uint8_t* end;
+    if (!file.Open(path) || !getRootChunks(file, begin, end))
+    {
+        return "";
+    }
+
+    const LVLFilter filter = buildFilter(contents, chosenLayers, common, cachedModels);
+    const uint64_t filteredSize = copyChunks(begin, end, filter, nullptr);
+    if (filteredSize > (end - begin) * MAX_FILTERED_RATIO || filteredSize > UINT32_MAX)
+    {
+        return "";
+    }
+
+    std::error_code err;
+    fs::path tmpPath = fs::temp_directory_path(err) / fmt::format("{0}.{1:08x}.lvl", fs::path(path).stem().u8string(), std::random_device()());
+    if (err)
+    {
+        return "";
+    }
+
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    const uint32_t rootSize = (uint32_t)filteredSize;
+    out.write("ucfb", 4);
+    out.write((const char*)&rootSize, 4);
+    copyChunks(begin, end, filter, &out);
+    if (!out)
+    {
+        out.close();
+        fs::remove(tmpPath, err);
+        return "";
+    }
+
+    LOG("Skipping {0} of {1} models and {2} sub LVLs which are either cached or not used by the chosen layers ({3} of {4} MB left)",
+        filter.m_DroppedModels.size(), contents.m_ModelTextures.size(), filter.m_DroppedSubLVLs.size(),
+        filteredSize / (1024 * 1024), (end - begin) / (1024 * 1024));
+    return tmpPath.u8string();
+}
+
+static Level* loadSubLVLs(const std::string& path, const LVLContents& contents, const std::vector<bool>& chosenLayers)
+{
+    const std::vector<LayerInfo>& layers = contents.m_Layers;
+    std::set<uint32_t> neededHashes;
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        if (chosenLayers[i] && layers[i].m_SubLVLHash != 0)
+        {
+            neededHashes.insert(layers[i].m_SubLVLHash);
+        }
+    }
+
+    // nothing to restrict if every sub LVL is needed anyway. Without any
+    // names to filter by, LibSWBF2 would load all sub LVLs as well
+    if (neededHashes.empty() || neededHashes.size() == contents.m_SubLVLHashes.size())
+    {
+        return Level::FromFile(path.c_str());
+    }
+
+    List<String> subLVLs;
+    for (uint32_t hash : neededHashes)
+    {
+        auto named = std::find_if(layers.begin(), layers.end(), [hash](const LayerInfo& layer)
+        {
+            return layer.m_SubLVLHash == hash && fnvHash(layer.m_Name) == hash;
+        });
+        if (named == layers.end())
+        {
+            return Level::FromFile(path.c_str());
+        }
+        subLVLs.Add(named->m_Name.c_str());
+    }
+    return Level::FromFile(path.c_str(), &subLVLs);
+}
+
+Level* loadLayers(
+    const std::string& path,
+    const LVLContents& contents,
+    const std::vector<bool>& chosenLayers,
+    const LVLContents* common,
+    const std::unordered_set<std::string>* cachedModels
+)
+{
+    const std::string filteredPath = writeFilteredLVL(path, contents, chosenLayers, common, cachedModels);
+    if (filteredPath.empty())
+    {
+        return loadSubLVLs(path, contents, chosenLayers);
+    }
+
+    // LibSWBF2 is done with the file once loaded
+    Level* lvl = Level::FromFile(filteredPath.c_str());
+    std::error_code err;
+    fs::remove(filteredPath, err);
+    return lvl;
+}
+
+std::vector<bool> matchLoadedLayers(const LVLContents& contents, const std::vector<bool>& chosenLayers, const std::vector<SourceLayer>& layers)
+{
+    std::set<std::string> chosenNames;
+    for (size_t i = 0; i < contents.m_Layers.size(); ++i)
+    {
+        if (chosenLayers[i])
+        {
+            chosenNames.insert(contents.m_Layers[i].m_Name);
+        }
+    }
+
+    std::vector<bool> chosenLoaded(layers.size(), false);
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        chosenLoaded[i] = chosenNames.count(layers[i].m_Name) > 0;
+    }
+    return chosenLoaded;
+}
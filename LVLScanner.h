@@ -0,0 +1,71 @@
+#pragma once
+#include "Common.h"
+#include "SourceData.h"
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A layer as found in the chunk headers of a LVL, without loading it
+struct LayerInfo
+{
+    std::string m_Name;
+    uint32_t m_NumInstances = 0;
+
+    // hash of the sub LVL ('lvl_' chunk) containing the layer, 0 for top level layers
+    uint32_t m_SubLVLHash = 0;
+
+    // lower case entity class names of all instances, and geometry names set on the instances directly
+    std::set<std::string> m_Classes;
+    std::set<std::string> m_Geometry;
+};
+
+// Entity class ('entc', 'ordc', 'wpnc' or 'expc' chunk). Empty geometry if it's inherited from the base class.
+struct ClassInfo
+{
+    std::string m_Base;
+    std::string m_Geometry;
+};
+
+struct LVLContents
+{
+    std::vector<LayerInfo> m_Layers;
+    std::set<uint32_t> m_SubLVLHashes;
+
+    // keyed by lower case name. Models list the lower case names of the textures they use
+    std::unordered_map<std::string, ClassInfo> m_Classes;
+    std::unordered_map<std::string, std::set<std::string>> m_ModelTextures;
+
+    // raw size of all 'modl' and 'tex_' chunks (sub LVLs included) and of the whole file, in bytes
+    uint64_t m_ModelBytes = 0;
+    uint64_t m_TextureBytes = 0;
+    uint64_t m_FileBytes = 0;
+};
+
+// Walks the chunk headers of a memory mapped LVL and collects its layers ('wrld' chunks), sub LVLs, entity
+// classes and models. Apart from a few small name and property chunks, only the pages holding the headers
+// get touched, so it takes milliseconds where loading the LVL takes seconds.
+bool scanLVL(const std::string& path, LVLContents& outContents);
+
+// Hashes every raw 'modl' chunk of a LVL (sub LVLs included), keyed by lower case model name.
+// Unlike scanLVL(), this reads all model data, but still is a lot faster than loading it.
+bool hashModels(const std::string& path, std::unordered_map<std::string, uint64_t>& outHashes);
+
+// Loads 'path' with just what the chosen layers ('chosenLayers' matches 'contents.m_Layers') need.
+// If most of the LVL can be skipped, a filtered copy without unused models, their textures and the sub LVLs of
+// unchosen layers gets written to the temp directory and loaded instead. Entity classes not defined in 'path'
+// get resolved in 'common', if given, which should be the scan of the common LVLs converted along with it.
+// Models in 'cachedModels' (lower case names) are left out as well, since they come from elsewhere. Their textures stay.
+// Otherwise only sub LVLs get skipped. LibSWBF2 filters them by name, but sub LVLs are identified by the hash
+// of their name only, so a name has to be recovered from the layers inside. Usually the layer is named just like
+// its sub LVL (e.g. "geo1_conquest"). If a sub LVL can't be named that way, everything gets loaded.
+Level* loadLayers(
+    const std::string& path,
+    const LVLContents& contents,
+    const std::vector<bool>& chosenLayers,
+    const LVLContents* common,
+    const std::unordered_set<std::string>* cachedModels = nullptr
+);
+
+// Flags the loaded 'layers' which are chosen in 'chosenLayers', by name
+std::vector<bool> matchLoadedLayers(const LVLContents& contents, const std::vector<bool>& chosenLayers, const std::vector<SourceLayer>& layers);
@@ -0,0 +1,309 @@
+#include "ModelConverter.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+
+static std::vector<uint8_t> copyBuffer(const Vector3* srcBuffer, uint32_t srcCount)
+{
+    std::vector<uint8_t> data((size_t)srcCount * sizeof(float) * 3);
+    for (uint32_t i = 0; i < srcCount; ++i)
+    {
+        size_t vecIdx = i * sizeof(float) * 3;
+        *reinterpret_cast<float*>(&data[vecIdx])                     = srcBuffer[i].m_X;
+        *reinterpret_cast<float*>(&data[vecIdx + sizeof(float)])     = srcBuffer[i].m_Y;
+        *reinterpret_cast<float*>(&data[vecIdx + sizeof(float) * 2]) = srcBuffer[i].m_Z;
+    }
+    return data;
+}
+
+// 'uvTransform' remaps the UVs into an atlas region, if set
+static std::vector<uint8_t> copyBuffer(const Vector2* srcBuffer, uint32_t srcCount, const UVTransform* uvTransform = nullptr)
+{
+    std::vector<uint8_t> data((size_t)srcCount * sizeof(float) * 2);
+    for (uint32_t i = 0; i < srcCount; ++i)
+    {
+        const Vector2 uv = uvTransform != nullptr ? uvTransform->Apply(srcBuffer[i]) : srcBuffer[i];
+        size_t vecIdx = i * sizeof(float) * 2;
+        *reinterpret_cast<float*>(&data[vecIdx])                 = uv.m_X;
+        *reinterpret_cast<float*>(&data[vecIdx + sizeof(float)]) = uv.m_Y;
+    }
+    return data;
+}
+
+static std::vector<uint8_t> copyBuffer(const uint16_t* srcBuffer, uint32_t srcCount)
+{
+    std::vector<uint8_t> data((size_t)srcCount * sizeof(uint16_t));
+    for (uint32_t i = 0; i < srcCount; ++i)
+    {
+        size_t vecIdx = i * sizeof(uint16_t);
+        *reinterpret_cast<uint16_t*>(&data[vecIdx]) = srcBuffer[i];
+    }
+    return data;
+}
+
+static int addAccessor(tinygltf::Model& dstModel, int bufferView, int componentType, int type, uint32_t count)
+{
+    tinygltf::Accessor& acc = dstModel.accessors.emplace_back();
+    acc.bufferView = bufferView;
+    acc.byteOffset = 0;
+    acc.componentType = componentType;
+    acc.type = type;
+    acc.count = count;
+    return (int)dstModel.accessors.size() - 1;
+}
+
+// Hands the serialized buffers over to 'dstBinary' and adds an accessor for each
+static void addBuffers(
+    std::vector<uint8_t>&& vertexData,
+    uint32_t numVertices,
+    std::vector<uint8_t>&& normalData,
+    uint32_t numNormals,
+    std::vector<uint8_t>&& uvData,
+    uint32_t numUVs,
+    std::vector<uint8_t>&& indexData,
+    uint32_t numIndices,
+    tinygltf::Model& dstModel,
+    BinaryWriter& dstBinary,
+    int& gltfVertexBufferAccIdx,
+    int& gltfNormalBufferAccIdx,
+    int& gltfUVBufferAccIdx,
+    int& gltfIndexBufferAccIdx
+)
+{
+    // everything goes into buffer 0, which becomes the binary chunk of a .glb
+    int view = dstBinary.AddBufferView(std::move(vertexData), sizeof(float) * 3);
+    gltfVertexBufferAccIdx = addAccessor(dstModel, view, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, numVertices);
+
+    view = dstBinary.AddBufferView(std::move(normalData), sizeof(float) * 3);
+    gltfNormalBufferAccIdx = addAccessor(dstModel, view, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, numNormals);
+
+    view = dstBinary.AddBufferView(std::move(uvData), sizeof(float) * 2);
+    gltfUVBufferAccIdx = addAccessor(dstModel, view, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2, numUVs);
+
+    view = dstBinary.AddBufferView(std::move(indexData), sizeof(uint16_t));
+    gltfIndexBufferAccIdx = addAccessor(dstModel, view, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, TINYGLTF_TYPE_SCALAR, numIndices);
+}
+
+void copyBuffers(
+    const Vector3*  swbfVertexBuffer,
+    uint32_t        swbfVertexBufferCount,
+    const Vector3*  swbfNormalBuffer,
+    uint32_t        swbfNormalBufferCount,
+    const Vector2*  swbfUVBuffer,
+    uint32_t        swbfUVBufferCount,
+    const uint16_t* swbfIndexBuffer,
+    uint32_t        swbfIndexBufferCount,
+    tinygltf::Model& dstModel,
+    BinaryWriter& dstBinary,
+    int& gltfVertexBufferAccIdx,
+    int& gltfNormalBufferAccIdx,
+    int& gltfUVBufferAccIdx,
+    int& gltfIndexBufferAccIdx
+)
+{
+    addBuffers(
+        copyBuffer(swbfVertexBuffer, swbfVertexBufferCount),
+        swbfVertexBufferCount,
+        copyBuffer(swbfNormalBuffer, swbfNormalBufferCount),
+        swbfNormalBufferCount,
+        copyBuffer(swbfUVBuffer, swbfUVBufferCount),
+        swbfUVBufferCount,
+        copyBuffer(swbfIndexBuffer, swbfIndexBufferCount),
+        swbfIndexBufferCount,
+        dstModel,
+        dstBinary,
+        gltfVertexBufferAccIdx,
+        gltfNormalBufferAccIdx,
+        gltfUVBufferAccIdx,
+        gltfIndexBufferAccIdx
+    );
+}
+
+int gltfTopology(ETopology topology)
+{
+    switch (topology)
+    {
+        case ETopology::LineList:
+            return TINYGLTF_MODE_LINE_LOOP;
+        case ETopology::LineStrip:
+            return TINYGLTF_MODE_LINE_STRIP;
+        case ETopology::PointList:
+            return TINYGLTF_MODE_POINTS;
+        case ETopology::TriangleFan:
+            return TINYGLTF_MODE_TRIANGLE_FAN;
+        case ETopology::TriangleList:
+            return TINYGLTF_MODE_TRIANGLES;
+        case ETopology::TriangleStrip:
+            return TINYGLTF_MODE_TRIANGLE_STRIP;
+        default:
+            LOG("Unknown ETopology type: {0}! Assuming Triangle List!", (int)topology);
+            return TINYGLTF_MODE_TRIANGLES;
+    }
+}
+
+
+ModelConverter::ModelConverter(tinygltf::Model& gltf, BinaryWriter& binary, TextureStage& textures, TaskPool& pool, size_t maxStaged, const std::atomic<bool>* cancelled) :
+    m_Gltf(gltf),
+    m_Binary(binary),
+    m_Textures(textures),
+    m_Pool(pool),
+    m_MaxStaged(maxStaged),
+    m_Cancelled(cancelled)
+{
+
+}
+
+void ModelConverter::Convert(const std::vector<Job>& jobs)
+{
+    std::vector<const Job*> todo;
+    for (const Job& job : jobs)
+    {
+        if (job.m_Model != nullptr && m_MeshIndices.emplace(job.m_GeometryName, -1).second)
+        {
+            todo.push_back(&job);
+        }
+    }
+    if (todo.empty())
+    {
+        return;
+    }
+
+    // the atlas layout is final at this point, workers only ever read this copy
+    const std::unordered_map<const SourceTexture*, UVTransform> atlasTransforms = m_Textures.GetAtlasTransforms();
+
+    std::vector<MeshStaging> staged(todo.size());
+    std::unique_ptr<std::atomic<bool>[]> done(new std::atomic<bool>[todo.size()]);
+    size_t numSubmitted = 0;
+    auto isCancelled = [this]()
+    {
+        return m_Cancelled != nullptr && m_Cancelled->load(std::memory_order_relaxed);
+    };
+    auto submitNext = [&]()
+    {
+        const size_t i = numSubmitted++;
+        done[i] = false;
+        m_Pool.Submit([&, i]()
+        {
+            if (!isCancelled())
+            {
+                Stage(*todo[i]->m_Model, atlasTransforms, staged[i]);
+            }
+            done[i].store(true, std::memory_order_release);
+        });
+    };
+
+    const size_t maxStaged = m_MaxStaged > 0 ? std::min(m_MaxStaged, todo.size()) : todo.size();
+    while (numSubmitted < maxStaged)
+    {
+        submitNext();
+    }
+
+    // merge in job order as soon as the next one is ready, freeing its staging data right away
+    for (size_t i = 0; i < todo.size(); ++i)
+    {
+        if (isCancelled())
+        {
+            // the submitted tasks still write into 'staged'
+            for (size_t j = i; j < numSubmitted; ++j)
+            {
+                m_Pool.WaitUntil([&]() { return done[j].load(std::memory_order_acquire); });
+            }
+            return;
+        }
+        m_Pool.WaitUntil([&]() { return done[i].load(std::memory_order_acquire); });
+        m_MeshIndices[todo[i]->m_GeometryName] = Merge(staged[i]);
+        staged[i] = MeshStaging();
+        if (numSubmitted < todo.size())
+        {
+            submitNext();
+        }
+    }
+}
+
+int ModelConverter::GetMeshIdx(const std::string& geometryName) const
+{
+    auto it = m_MeshIndices.find(geometryName);
+    return it != m_MeshIndices.end() ? it->second : -1;
+}
+
+void ModelConverter::Stage(const SourceModel& model, const std::unordered_map<const SourceTexture*, UVTransform>& atlasTransforms, MeshStaging& outMesh)
+{
+    outMesh.m_Name = model.m_Name;
+
+    outMesh.m_Primitives.resize(model.m_Segments.size());
+    for (size_t k = 0; k < model.m_Segments.size(); ++k)
+    {
+        const SourceSegment& segm = model.m_Segments[k];
+        PrimitiveStaging& prim = outMesh.m_Primitives[k];
+
+        prim.m_DiffuseColor = segm.m_DiffuseColor;
+        prim.m_Texture = segm.m_Texture;
+        prim.m_Topology = segm.m_Topology;
+
+        prim.m_VertexData = copyBuffer(segm.m_Vertices, segm.m_NumVertices);
+        prim.m_NumVertices = segm.m_NumVertices;
+        prim.m_NormalData = copyBuffer(segm.m_Normals, segm.m_NumNormals);
+        prim.m_NumNormals = segm.m_NumNormals;
+        prim.m_IndexData = copyBuffer(segm.m_Indices, segm.m_NumIndices);
+        prim.m_NumIndices = segm.m_NumIndices;
+
+        // atlased textures need the UVs remapped into their atlas region
+        auto it = atlasTransforms.find(prim.m_Texture);
+        const bool bAtlased = it != atlasTransforms.end() && !it->second.IsIdentity();
+        prim.m_UVData = copyBuffer(segm.m_UVs, segm.m_NumUVs, bAtlased ? &it->second : nullptr);
+        prim.m_NumUVs = segm.m_NumUVs;
+    }
+}
+
+int ModelConverter::Merge(MeshStaging& mesh)
+{
+    tinygltf::Mesh& gltfMesh = m_Gltf.meshes.emplace_back();
+    int meshIdx = (int)m_Gltf.meshes.size() - 1;
+    gltfMesh.name = mesh.m_Name;
+
+    LOG("Converting mesh '{0}'", gltfMesh.name.c_str());
+
+    for (PrimitiveStaging& staged : mesh.m_Primitives)
+    {
+        int gltfVertexBufferAccIdx = 0;
+        int gltfNormalBufferAccIdx = 0;
+        int gltfUVBufferAccIdx = 0;
+        int gltfIndexBufferAccIdx = 0;
+
+        // UVs are already transformed, if atlased
+        UVTransform uvTransform;
+        int matIdx = m_Textures.GetMaterial(staged.m_DiffuseColor, staged.m_Texture, uvTransform);
+
+        addBuffers(
+            std::move(staged.m_VertexData),
+            staged.m_NumVertices,
+            std::move(staged.m_NormalData),
+            staged.m_NumNormals,
+            std::move(staged.m_UVData),
+            staged.m_NumUVs,
+            std::move(staged.m_IndexData),
+            staged.m_NumIndices,
+            m_Gltf,
+            m_Binary,
+            gltfVertexBufferAccIdx,
+            gltfNormalBufferAccIdx,
+            gltfUVBufferAccIdx,
+            gltfIndexBufferAccIdx
+        );
+
+        // 'gltfMesh' might got invalidated by now
+        tinygltf::Primitive& prim = m_Gltf.meshes[meshIdx].primitives.emplace_back();
+        prim.attributes =
+        {
+            { "POSITION",   gltfVertexBufferAccIdx },
+            { "NORMAL",     gltfNormalBufferAccIdx },
+            { "TEXCOORD_0", gltfUVBufferAccIdx     },
+        };
+
+        prim.indices = gltfIndexBufferAccIdx;
+        prim.mode = gltfTopology(staged.m_Topology);
+        prim.material = matIdx;
+    }
+    return meshIdx;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "Common.h"
+#include "BinaryWriter.h"
+#include "SourceData.h"
+#include "TextureStage.h"
+#include "TaskPool.h"
+#include <atomic>
+#include <unordered_map>
+
+void copyBuffers(
+    const Vector3*  swbfVertexBuffer,
+    uint32_t        swbfVertexBufferCount,
+    const Vector3*  swbfNormalBuffer,
+    uint32_t        swbfNormalBufferCount,
+    const Vector2*  swbfUVBuffer,
+    uint32_t        swbfUVBufferCount,
+    const uint16_t* swbfIndexBuffer,
+    uint32_t        swbfIndexBufferCount,
+    tinygltf::Model& dstModel,
+    BinaryWriter& dstBinary,
+    int& gltfVertexBufferAccIdx,
+    int& gltfNormalBufferAccIdx,
+    int& gltfUVBufferAccIdx,
+    int& gltfIndexBufferAccIdx
+);
+
+int gltfTopology(ETopology topology);
+
+// Converts SWBF2 models into glTF meshes, one mesh per geometry name.
+// Serializing the segment data into the final buffer bytes runs in parallel on the task pool, while
+// everything touching the glTF model (buffer views, accessors, materials, textures) happens on the
+// calling thread, strictly in job order. So the output doesn't depend on the thread count.
+class ModelConverter
+{
+public:
+    struct Job
+    {
+        std::string m_GeometryName;
+        const SourceModel* m_Model = nullptr;
+    };
+
+    // At most 'maxStaged' models get serialized ahead of the one merged next, 0 for no limit.
+    // Staged models hold their serialized buffers until merged, so this bounds the extra memory.
+    // Once 'cancelled' is set, no further models get converted.
+    ModelConverter(tinygltf::Model& gltf, BinaryWriter& binary, TextureStage& textures, TaskPool& pool, size_t maxStaged = 0, const std::atomic<bool>* cancelled = nullptr);
+
+    // Jobs for already converted geometry names are skipped.
+    // Textures have to be packed (if atlasing) before calling this.
+    void Convert(const std::vector<Job>& jobs);
+
+    // Returns -1 if no mesh was converted for the given geometry name
+    int GetMeshIdx(const std::string& geometryName) const;
+
+private:
+    // buffer contents exactly as they end up in the binary chunk
+    struct PrimitiveStaging
+    {
+        std::vector<uint8_t> m_VertexData;
+        uint32_t m_NumVertices = 0;
+        std::vector<uint8_t> m_NormalData;
+        uint32_t m_NumNormals = 0;
+        std::vector<uint8_t> m_UVData;
+        uint32_t m_NumUVs = 0;
+        std::vector<uint8_t> m_IndexData;
+        uint32_t m_NumIndices = 0;
+        ETopology m_Topology = ETopology::TriangleList;
+        Color4u8 m_DiffuseColor;
+        const SourceTexture* m_Texture = nullptr;
+    };
+
+    struct MeshStaging
+    {
+        std::string m_Name;
+        std::vector<PrimitiveStaging> m_Primitives;
+    };
+
+    // Runs on the pool workers. Serializes the buffers straight out of the views of 'model', with atlased UVs
+    // already remapped. The views got read from LibSWBF2 under its lock when the model was looked up
+    // (see SourceData.cpp), so no LibSWBF2 calls happen concurrently.
+    static void Stage(const SourceModel& model, const std::unordered_map<const SourceTexture*, UVTransform>& atlasTransforms, MeshStaging& outMesh);
+
+    // Hands the staged buffers over to the binary writer, so 'mesh' is left without them
+    int Merge(MeshStaging& mesh);
+
+    tinygltf::Model& m_Gltf;
+    BinaryWriter& m_Binary;
+    TextureStage& m_Textures;
+    TaskPool& m_Pool;
+    size_t m_MaxStaged;
+    const std::atomic<bool>* m_Cancelled;
+    std::unordered_map<std::string, int> m_MeshIndices;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include "TaskPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+// Runs 'func(i)' for every i in [0, count) on the workers of 'pool' and the calling thread, which helps
+// out instead of waiting. Without a pool, everything runs on the calling thread.
+// Work items are handed out one by one, so uneven item costs balance out.
+template<class Func>
+void parallelFor(TaskPool* pool, uint32_t count, Func&& func)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    std::atomic<uint32_t> next = 0;
+    auto worker = [&]()
+    {
+        for (uint32_t i = next++; i < count; i = next++)
+        {
+            func(i);
+        }
+    };
+
+    const uint32_t numHelpers = pool != nullptr ? std::min(count - 1, pool->GetNumThreads()) : 0;
+    std::atomic<uint32_t> numDone = 0;
+    for (uint32_t t = 0; t < numHelpers; ++t)
+    {
+        pool->Submit([&]()
+        {
+            worker();
+            numDone++;
+        });
+    }
+    worker();
+
+    // the helpers reference 'worker', so they have to be done before returning, even if there was nothing left for them
+    if (numHelpers > 0)
+    {
+        pool->WaitUntil([&]() { return numDone == numHelpers; });
+    }
+}
@@ -0,0 +1,798 @@
+#include "ParseCache.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <type_traits>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+constexpr uint32_t CACHE_MAGIC = 0x5047324C;    // "L2GP"
+constexpr uint32_t MODEL_MAGIC = 0x4D47324C;    // "L2GM"
+
+// bump whenever the layout below changes, older entries simply miss then
+constexpr uint32_t CACHE_VERSION = 2;
+
+// textures don't have more mip levels than that
+constexpr uint8_t MAX_MIP_LEVELS = 16;
+
+
+// An array somewhere in the file. Every array starts 8 byte aligned, so its content can be used in place.
+struct Span
+{
+    uint64_t m_Offset = 0;
+    uint64_t m_Count = 0;
+};
+
+struct FileHeader
+{
+    uint32_t m_Magic = CACHE_MAGIC;
+    uint32_t m_Version = CACHE_VERSION;
+    uint64_t m_Key = 0;
+    uint32_t m_bTextures = 0;
+    uint32_t m_Padding = 0;
+    Span m_Textures;        // TextureRecord
+    Span m_TextureNames;    // NameRecord
+    Span m_Models;          // ModelRecord
+    Span m_Layers;          // LayerRecord
+};
+
+struct MipRecord
+{
+    uint16_t m_Width = 0;
+    uint16_t m_Height = 0;
+    uint32_t m_Padding = 0;
+    Span m_RGBA;
+};
+
+struct TextureRecord
+{
+    Span m_Name;
+    Span m_Mips;            // MipRecord
+};
+
+// lower case lookup name -> texture
+struct NameRecord
+{
+    Span m_Key;
+    int32_t m_Texture = -1;
+    uint32_t m_Padding = 0;
+};
+
+struct SegmentRecord
+{
+    Span m_Vertices;
+    Span m_Normals;
+    Span m_UVs;
+    Span m_Indices;
+    int32_t m_Topology = 0;
+    Color4u8 m_DiffuseColor;
+    int32_t m_Texture = -1;
+    uint32_t m_Padding = 0;
+};
+
+struct ModelRecord
+{
+    Span m_Key;
+    Span m_Name;
+    Span m_Segments;        // SegmentRecord
+    uint32_t m_bWorld = 0;  // see SourceModel::m_bWorld
+    uint32_t m_Padding = 0;
+};
+
+// A single model on its own, see ParseCache::LoadModels()
+struct ModelHeader
+{
+    uint32_t m_Magic = MODEL_MAGIC;
+    uint32_t m_Version = CACHE_VERSION;
+    uint64_t m_Key = 0;
+    Span m_Name;
+    Span m_Segments;        // SegmentRecord, 'm_Texture' indexes 'm_TextureNames'
+    Span m_TextureNames;    // Span, one per name
+};
+
+struct InstanceRecord
+{
+    Span m_Name;
+    Span m_Geometry;
+    Vector3 m_Position;
+    Vector4 m_Rotation;
+    uint32_t m_Padding = 0;
+};
+
+struct LayerRecord
+{
+    Span m_Name;
+    Span m_Instances;       // InstanceRecord
+    uint32_t m_bHasTerrain = 0;
+    uint32_t m_BlendDim = 0;
+    uint32_t m_NumBlendLayers = 0;
+    uint32_t m_Padding = 0;
+    Span m_TerrainName;
+    Span m_Vertices;
+    Span m_Normals;
+    Span m_UVs;
+    Span m_Indices;
+    Span m_BlendMap;
+    Span m_LayerTextures;   // Span, one per name
+};
+
+
+class CacheWriter
+{
+public:
+    // the header gets filled in last
+    CacheWriter(const std::string& path, size_t headerSize) :
+        m_File(path, std::ios::binary | std::ios::trunc)
+    {
+        static const char PLACEHOLDER[sizeof(FileHeader)] = {};
+        Write(PLACEHOLDER, headerSize);
+    }
+
+    template<class T>
+    Span Add(const T* data, size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be stored!");
+        static const char PADDING[8] = {};
+        Write(PADDING, (size_t)((8 - m_Offset % 8) % 8));
+
+        Span span = { m_Offset, count };
+        Write(data, count * sizeof(T));
+        return span;
+    }
+
+    template<class T>
+    Span Add(const std::vector<T>& values)
+    {
+        return Add(values.data(), values.size());
+    }
+
+    Span Add(const std::string& str)
+    {
+        return Add(str.data(), str.size());
+    }
+
+    template<class Header>
+    bool Finish(const Header& header)
+    {
+        static_assert(sizeof(Header) <= sizeof(FileHeader), "Header is larger than the placeholder!");
+        m_File.seekp(0);
+        m_File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        m_File.close();
+        return !m_File.fail();
+    }
+
+private:
+    void Write(const void* data, size_t size)
+    {
+        m_File.write(static_cast<const char*>(data), (std::streamsize)size);
+        m_Offset += size;
+    }
+
+    std::ofstream m_File;
+    uint64_t m_Offset = 0;
+};
+
+class CacheReader
+{
+public:
+    CacheReader(const MappedFile& file) :
+        m_File(file)
+    {
+
+    }
+
+    template<class T>
+    bool Get(const Span& span, const T*& outData) const
+    {
+        const uint64_t size = m_File.GetSize();
+        if (span.m_Offset % alignof(T) != 0 || span.m_Offset > size || span.m_Count > (size - span.m_Offset) / sizeof(T))
+        {
+            return false;
+        }
+        outData = span.m_Count > 0 ? reinterpret_cast<const T*>(m_File.GetData() + span.m_Offset) : nullptr;
+        return true;
+    }
+
+    // for the 32 bit counts LibSWBF2 uses
+    template<class T>
+    bool Get(const Span& span, const T*& outData, uint32_t& outCount) const
+    {
+        outCount = (uint32_t)span.m_Count;
+        return span.m_Count <= UINT32_MAX && Get(span, outData);
+    }
+
+    bool Get(const Span& span, std::string& outStr) const
+    {
+        const char* chars = nullptr;
+        if (!Get(span, chars))
+        {
+            return false;
+        }
+        outStr.assign(chars, (size_t)span.m_Count);
+        return true;
+    }
+
+private:
+    const MappedFile& m_File;
+};
+
+
+static std::string toLower(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(), [](char c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; });
+    return str;
+}
+
+static uint64_t hashFile(const std::string& path)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        return 0;
+    }
+    return Hasher().Add(file.GetData(), file.GetSize()).Get();
+}
+
+// Writes the entry to a temporary file first and renames it when done,
+// so concurrent readers never get to see a partially written entry
+template<class Header>
+static bool finishEntry(CacheWriter& writer, const Header& header, const std::string& tmpPath, const std::string& path)
+{
+    std::error_code err;
+    if (!writer.Finish(header))
+    {
+        LOG("Could not write parse cache entry '{0}'!", tmpPath.c_str());
+        fs::remove(tmpPath, err);
+        return false;
+    }
+    fs::rename(tmpPath, path, err);
+    if (err)
+    {
+        fs::remove(tmpPath, err);
+        return false;
+    }
+    return true;
+}
+
+static std::string getTempPath(const std::string& path)
+{
+    return fmt::format("{0}.{1:08x}.tmp", path, std::random_device()());
+}
+
+static SegmentRecord writeSegment(CacheWriter& writer, const SourceSegment& seg, int32_t texture)
+{
+    SegmentRecord record;
+    record.m_Vertices = writer.Add(seg.m_Vertices, seg.m_NumVertices);
+    record.m_Normals = writer.Add(seg.m_Normals, seg.m_NumNormals);
+    record.m_UVs = writer.Add(seg.m_UVs, seg.m_NumUVs);
+    record.m_Indices = writer.Add(seg.m_Indices, seg.m_NumIndices);
+    record.m_Topology = (int32_t)seg.m_Topology;
+    record.m_DiffuseColor = seg.m_DiffuseColor;
+    record.m_Texture = texture;
+    return record;
+}
+
+// The texture gets resolved by the caller
+static bool readSegment(const CacheReader& reader, const SegmentRecord& record, SourceSegment& outSeg)
+{
+    if (!reader.Get(record.m_Vertices, outSeg.m_Vertices, outSeg.m_NumVertices) ||
+        !reader.Get(record.m_Normals, outSeg.m_Normals, outSeg.m_NumNormals) ||
+        !reader.Get(record.m_UVs, outSeg.m_UVs, outSeg.m_NumUVs) ||
+        !reader.Get(record.m_Indices, outSeg.m_Indices, outSeg.m_NumIndices))
+    {
+        return false;
+    }
+    outSeg.m_Topology = (ETopology)record.m_Topology;
+    outSeg.m_DiffuseColor = record.m_DiffuseColor;
+    return true;
+}
+
+static bool readTextures(
+    const CacheReader& reader,
+    const FileHeader& header,
+    std::vector<std::unique_ptr<SourceTexture>>& outTextures,
+    std::unordered_map<std::string, const SourceTexture*>& outTexturesByName
+)
+{
+    const TextureRecord* textures = nullptr;
+    const NameRecord* names = nullptr;
+    if (!reader.Get(header.m_Textures, textures) || !reader.Get(header.m_TextureNames, names))
+    {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < header.m_Textures.m_Count; ++i)
+    {
+        SourceTexture& texture = *outTextures.emplace_back(std::make_unique<SourceTexture>());
+        const MipRecord* mips = nullptr;
+        if (!reader.Get(textures[i].m_Name, texture.m_Name) || !reader.Get(textures[i].m_Mips, mips))
+        {
+            return false;
+        }
+
+        for (uint64_t j = 0; j < textures[i].m_Mips.m_Count; ++j)
+        {
+            SourceTexture::Mip& mip = texture.m_Mips.emplace_back();
+            mip.m_Width = mips[j].m_Width;
+            mip.m_Height = mips[j].m_Height;
+            if (mips[j].m_RGBA.m_Count != (uint64_t)mip.m_Width * mip.m_Height * 4 || !reader.Get(mips[j].m_RGBA, mip.m_RGBA))
+            {
+                return false;
+            }
+        }
+    }
+
+    for (uint64_t i = 0; i < header.m_TextureNames.m_Count; ++i)
+    {
+        std::string key;
+        if (!reader.Get(names[i].m_Key, key) || names[i].m_Texture < 0 || names[i].m_Texture >= (int32_t)outTextures.size())
+        {
+            return false;
+        }
+        outTexturesByName[key] = outTextures[names[i].m_Texture].get();
+    }
+    return true;
+}
+
+static bool readModels(
+    const CacheReader& reader,
+    const FileHeader& header,
+    const std::vector<std::unique_ptr<SourceTexture>>& textures,
+    std::unordered_map<std::string, std::unique_ptr<SourceModel>>& outModels
+)
+{
+    const ModelRecord* models = nullptr;
+    if (!reader.Get(header.m_Models, models))
+    {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < header.m_Models.m_Count; ++i)
+    {
+        std::string key;
+        const SegmentRecord* segments = nullptr;
+        std::unique_ptr<SourceModel> model = std::make_unique<SourceModel>();
+        if (!reader.Get(models[i].m_Key, key) || !reader.Get(models[i].m_Name, model->m_Name) || !reader.Get(models[i].m_Segments, segments))
+        {
+            return false;
+        }
+
+        model->m_bWorld = models[i].m_bWorld != 0;
+        model->m_Segments.resize((size_t)models[i].m_Segments.m_Count);
+        for (size_t k = 0; k < model->m_Segments.size(); ++k)
+        {
+            const SegmentRecord& record = segments[k];
+            SourceSegment& seg = model->m_Segments[k];
+            if (!readSegment(reader, record, seg) || record.m_Texture >= (int32_t)textures.size())
+            {
+                return false;
+            }
+            seg.m_Texture = record.m_Texture >= 0 ? textures[record.m_Texture].get() : nullptr;
+        }
+        outModels[key] = std::move(model);
+    }
+    return true;
+}
+
+static bool readLayers(const CacheReader& reader, const FileHeader& header, std::vector<SourceLayer>& outLayers)
+{
+    const LayerRecord* layers = nullptr;
+    if (!reader.Get(header.m_Layers, layers))
+    {
+        return false;
+    }
+
+    outLayers.resize((size_t)header.m_Layers.m_Count);
+    for (size_t i = 0; i < outLayers.size(); ++i)
+    {
+        const LayerRecord& record = layers[i];
+        SourceLayer& layer = outLayers[i];
+        const InstanceRecord* instances = nullptr;
+        if (!reader.Get(record.m_Name, layer.m_Name) || !reader.Get(record.m_Instances, instances))
+        {
+            return false;
+        }
+
+        layer.m_Instances.resize((size_t)record.m_Instances.m_Count);
+        for (size_t j = 0; j < layer.m_Instances.size(); ++j)
+        {
+            SourceInstance& inst = layer.m_Instances[j];
+            if (!reader.Get(instances[j].m_Name, inst.m_Name) || !reader.Get(instances[j].m_Geometry, inst.m_Geometry))
+            {
+                return false;
+            }
+            inst.m_Position = instances[j].m_Position;
+            inst.m_Rotation = instances[j].m_Rotation;
+        }
+
+        if (record.m_bHasTerrain == 0)
+        {
+            continue;
+        }
+
+        layer.m_Terrain = std::make_unique<SourceTerrain>();
+        SourceTerrain& terrain = *layer.m_Terrain;
+        terrain.m_BlendDim = record.m_BlendDim;
+        terrain.m_NumLayers = record.m_NumBlendLayers;
+        const Span* layerTextures = nullptr;
+        if (!reader.Get(record.m_TerrainName, terrain.m_Name) ||
+            !reader.Get(record.m_Vertices, terrain.m_Vertices, terrain.m_NumVertices) ||
+            !reader.Get(record.m_Normals, terrain.m_Normals, terrain.m_NumNormals) ||
+            !reader.Get(record.m_UVs, terrain.m_UVs, terrain.m_NumUVs) ||
+            !reader.Get(record.m_Indices, terrain.m_Indices, terrain.m_NumIndices) ||
+            record.m_BlendMap.m_Count != (uint64_t)terrain.m_BlendDim * terrain.m_BlendDim * terrain.m_NumLayers ||
+            !reader.Get(record.m_BlendMap, terrain.m_BlendMap) ||
+            !reader.Get(record.m_LayerTextures, layerTextures))
+        {
+            return false;
+        }
+
+        terrain.m_LayerTextures.resize((size_t)record.m_LayerTextures.m_Count);
+        for (size_t j = 0; j < terrain.m_LayerTextures.size(); ++j)
+        {
+            if (!reader.Get(layerTextures[j], terrain.m_LayerTextures[j]))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+ParseCache::ParseCache(const std::string& directory, const std::string& commonLVL) :
+    m_Directory(directory)
+{
+    if (m_Directory.empty())
+    {
+        return;
+    }
+
+    std::error_code err;
+    fs::create_directories(m_Directory, err);
+    if (err)
+    {
+        LOG("Could not create parse cache directory '{0}': {1}. Parse caching is disabled!", m_Directory.c_str(), err.message().c_str());
+        m_Directory.clear();
+        return;
+    }
+
+    // the same for every world LVL, so only hash it once
+    if (!commonLVL.empty())
+    {
+        m_CommonKey = hashFile(commonLVL);
+    }
+}
+
+bool ParseCache::IsEnabled() const
+{
+    return !m_Directory.empty();
+}
+
+uint64_t ParseCache::GetKey(const std::string& worldLVL) const
+{
+    return Hasher(CACHE_VERSION).Add(hashFile(worldLVL)).Add(m_CommonKey).Get();
+}
+
+std::unique_ptr<SourceScene> ParseCache::Load(uint64_t key, bool bTextures) const
+{
+    if (!IsEnabled())
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+    const std::string path = GetPath(key);
+    if (!file->Open(path) || file->GetSize() < sizeof(FileHeader))
+    {
+        return nullptr;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, file->GetData(), sizeof(header));
+    if (header.m_Magic != CACHE_MAGIC || header.m_Version != CACHE_VERSION || header.m_Key != key)
+    {
+        return nullptr;
+    }
+    if (bTextures && header.m_bTextures == 0)
+    {
+        return nullptr;
+    }
+
+    // the constructor is private to us
+    std::unique_ptr<SourceScene> scene(new SourceScene());
+    CacheReader reader(*file);
+    if (!readTextures(reader, header, scene->m_Textures, scene->m_TexturesByName) ||
+        !readModels(reader, header, scene->m_Textures, scene->m_Models) ||
+        !readLayers(reader, header, scene->m_Layers))
+    {
+        LOG("Parse cache entry '{0}' is damaged, ignoring it!", path.c_str());
+        return nullptr;
+    }
+    scene->m_CacheFiles.push_back(std::move(file));
+    return scene;
+}
+
+bool ParseCache::Store(uint64_t key, const SourceScene& scene, bool bTextures) const
+{
+    if (!IsEnabled())
+    {
+        return false;
+    }
+
+    // look up everything the layers use first, so it's all part of the scene
+    const std::vector<SourceLayer>& layers = scene.GetLayers();
+    for (const SourceLayer& layer : layers)
+    {
+        for (const SourceInstance& inst : layer.m_Instances)
+        {
+            if (!inst.m_Geometry.empty())
+            {
+                scene.FindModel(inst.m_Geometry);
+            }
+        }
+        if (bTextures && layer.m_Terrain != nullptr)
+        {
+            for (const std::string& texture : layer.m_Terrain->m_LayerTextures)
+            {
+                scene.FindTexture(texture);
+            }
+        }
+    }
+
+    const std::string path = GetPath(key);
+    const std::string tmpPath = getTempPath(path);
+    CacheWriter writer(tmpPath, sizeof(FileHeader));
+    FileHeader header;
+    header.m_Key = key;
+    header.m_bTextures = bTextures ? 1 : 0;
+
+    std::lock_guard<std::mutex> lock(scene.m_Mutex);
+
+    std::unordered_map<const SourceTexture*, int32_t> textureIndices;
+    if (bTextures)
+    {
+        std::vector<TextureRecord> textures;
+        for (const std::unique_ptr<SourceTexture>& texture : scene.m_Textures)
+        {
+            std::vector<MipRecord> mips;
+            for (uint8_t level = 0; level < MAX_MIP_LEVELS; ++level)
+            {
+                MipRecord& mip = mips.emplace_back();
+                const uint8_t* data = nullptr;
+                if (!texture->GetImageData(level, mip.m_Width, mip.m_Height, data) || data == nullptr || mip.m_Width == 0 || mip.m_Height == 0)
+                {
+                    mips.pop_back();
+                    break;
+                }
+                mip.m_RGBA = writer.Add(data, (size_t)mip.m_Width * mip.m_Height * 4);
+                if (mip.m_Width == 1 && mip.m_Height == 1)
+                {
+                    break;
+                }
+            }
+
+            TextureRecord& record = textures.emplace_back();
+            record.m_Name = writer.Add(texture->m_Name);
+            record.m_Mips = writer.Add(mips);
+            textureIndices[texture.get()] = (int32_t)textures.size() - 1;
+        }
+        header.m_Textures = writer.Add(textures);
+
+        std::vector<NameRecord> names;
+        for (const auto& it : scene.m_TexturesByName)
+        {
+            NameRecord& record = names.emplace_back();
+            record.m_Key = writer.Add(it.first);
+            record.m_Texture = textureIndices[it.second];
+        }
+        header.m_TextureNames = writer.Add(names);
+    }
+
+    std::vector<ModelRecord> models;
+    for (const auto& it : scene.m_Models)
+    {
+        const SourceModel& model = *it.second;
+        std::vector<SegmentRecord> segments;
+        for (const SourceSegment& seg : model.m_Segments)
+        {
+            auto texIt = textureIndices.find(seg.m_Texture);
+            segments.push_back(writeSegment(writer, seg, texIt != textureIndices.end() ? texIt->second : -1));
+        }
+
+        ModelRecord& record = models.emplace_back();
+        record.m_Key = writer.Add(it.first);
+        record.m_Name = writer.Add(model.m_Name);
+        record.m_Segments = writer.Add(segments);
+        record.m_bWorld = model.m_bWorld ? 1 : 0;
+    }
+    header.m_Models = writer.Add(models);
+
+    std::vector<LayerRecord> layerRecords;
+    for (const SourceLayer& layer : layers)
+    {
+        std::vector<InstanceRecord> instances;
+        for (const SourceInstance& inst : layer.m_Instances)
+        {
+            InstanceRecord& record = instances.emplace_back();
+            record.m_Name = writer.Add(inst.m_Name);
+            record.m_Geometry = writer.Add(inst.m_Geometry);
+            record.m_Position = inst.m_Position;
+            record.m_Rotation = inst.m_Rotation;
+        }
+
+        LayerRecord record;
+        record.m_Name = writer.Add(layer.m_Name);
+        record.m_Instances = writer.Add(instances);
+        if (layer.m_Terrain != nullptr)
+        {
+            const SourceTerrain& terrain = *layer.m_Terrain;
+            std::vector<Span> layerTextures;
+            for (const std::string& texture : terrain.m_LayerTextures)
+            {
+                layerTextures.emplace_back(writer.Add(texture));
+            }
+
+            record.m_bHasTerrain = 1;
+            record.m_BlendDim = terrain.m_BlendDim;
+            record.m_NumBlendLayers = terrain.m_NumLayers;
+            record.m_TerrainName = writer.Add(terrain.m_Name);
+            record.m_Vertices = writer.Add(terrain.m_Vertices, terrain.m_NumVertices);
+            record.m_Normals = writer.Add(terrain.m_Normals, terrain.m_NumNormals);
+            record.m_UVs = writer.Add(terrain.m_UVs, terrain.m_NumUVs);
+            record.m_Indices = writer.Add(terrain.m_Indices, terrain.m_NumIndices);
+            record.m_BlendMap = writer.Add(terrain.m_BlendMap, terrain.m_BlendMap != nullptr ? (size_t)terrain.m_BlendDim * terrain.m_BlendDim * terrain.m_NumLayers : 0);
+            record.m_LayerTextures = writer.Add(layerTextures);
+            if (terrain.m_BlendMap == nullptr)
+            {
+                record.m_BlendDim = 0;
+                record.m_NumBlendLayers = 0;
+            }
+        }
+        layerRecords.push_back(record);
+    }
+    header.m_Layers = writer.Add(layerRecords);
+    return finishEntry(writer, header, tmpPath, path);
+}
+
+std::unique_ptr<SourceScene> ParseCache::LoadModels(const std::unordered_map<std::string, uint64_t>& modelHashes, std::unordered_set<std::string>& outNames) const
+{
+    if (!IsEnabled())
+    {
+        return nullptr;
+    }
+
+    // textures are only known by name here, the scene using these models looks them up again
+    std::unique_ptr<SourceScene> scene(new SourceScene());
+    std::unordered_map<std::string, const SourceTexture*> textures;
+    for (const auto& [name, hash] : modelHashes)
+    {
+        std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+        const std::string path = GetModelPath(hash);
+        if (!file->Open(path) || file->GetSize() < sizeof(ModelHeader))
+        {
+            continue;
+        }
+
+        ModelHeader header;
+        std::memcpy(&header, file->GetData(), sizeof(header));
+        if (header.m_Magic != MODEL_MAGIC || header.m_Version != CACHE_VERSION || header.m_Key != hash)
+        {
+            continue;
+        }
+
+        CacheReader reader(*file);
+        std::unique_ptr<SourceModel> model = std::make_unique<SourceModel>();
+        const SegmentRecord* segments = nullptr;
+        const Span* textureNames = nullptr;
+        bool bValid = reader.Get(header.m_Name, model->m_Name) && reader.Get(header.m_Segments, segments) && reader.Get(header.m_TextureNames, textureNames);
+
+        model->m_Segments.resize(bValid ? (size_t)header.m_Segments.m_Count : 0);
+        for (size_t k = 0; k < model->m_Segments.size() && bValid; ++k)
+        {
+            const SegmentRecord& record = segments[k];
+            SourceSegment& seg = model->m_Segments[k];
+            std::string textureName;
+            bValid = readSegment(reader, record, seg) && record.m_Texture < (int64_t)header.m_TextureNames.m_Count;
+            if (bValid && record.m_Texture >= 0)
+            {
+                bValid = reader.Get(textureNames[record.m_Texture], textureName);
+            }
+            if (bValid && record.m_Texture >= 0)
+            {
+                const SourceTexture*& texture = textures[textureName];
+                if (texture == nullptr)
+                {
+                    texture = scene->m_Textures.emplace_back(std::make_unique<SourceTexture>()).get();
+                    scene->m_Textures.back()->m_Name = textureName;
+                }
+                seg.m_Texture = texture;
+            }
+        }
+        if (!bValid)
+        {
+            LOG("Parse cache entry '{0}' is damaged, ignoring it!", path.c_str());
+            continue;
+        }
+
+        scene->m_Models[name] = std::move(model);
+        scene->m_CacheFiles.push_back(std::move(file));
+        outNames.insert(name);
+    }
+
+    if (outNames.empty())
+    {
+        return nullptr;
+    }
+    LOG("Reusing {0} of {1} models from the parse cache", outNames.size(), modelHashes.size());
+    return scene;
+}
+
+void ParseCache::StoreModels(const std::unordered_map<std::string, uint64_t>& modelHashes, const SourceScene& scene) const
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    std::unordered_set<std::string> used;
+    for (const SourceLayer& layer : scene.GetLayers())
+    {
+        for (const SourceInstance& inst : layer.m_Instances)
+        {
+            used.insert(toLower(inst.m_Geometry));
+        }
+    }
+
+    for (const std::string& name : used)
+    {
+        auto hashIt = modelHashes.find(name);
+        std::error_code err;
+        if (hashIt == modelHashes.end() || fs::exists(GetModelPath(hashIt->second), err))
+        {
+            continue;
+        }
+        const SourceModel* model = scene.FindWorldModel(name);
+        if (model == nullptr)
+        {
+            continue;
+        }
+
+        const std::string path = GetModelPath(hashIt->second);
+        const std::string tmpPath = getTempPath(path);
+        CacheWriter writer(tmpPath, sizeof(ModelHeader));
+        ModelHeader header;
+        header.m_Key = hashIt->second;
+
+        std::vector<SegmentRecord> segments;
+        std::vector<Span> textureNames;
+        for (const SourceSegment& seg : model->m_Segments)
+        {
+            int32_t texture = -1;
+            if (seg.m_Texture != nullptr)
+            {
+                texture = (int32_t)textureNames.size();
+                textureNames.push_back(writer.Add(seg.m_Texture->m_Name));
+            }
+            segments.push_back(writeSegment(writer, seg, texture));
+        }
+        header.m_Name = writer.Add(model->m_Name);
+        header.m_Segments = writer.Add(segments);
+        header.m_TextureNames = writer.Add(textureNames);
+        finishEntry(writer, header, tmpPath, path);
+    }
+}
+
+std::string ParseCache::GetPath(uint64_t key) const
+{
+    return (fs::path(m_Directory) / fmt::format("{0:016x}.lvlcache", key)).u8string();
+}
+
+std::string ParseCache::GetModelPath(uint64_t modelHash) const
+{
+    return (fs::path(m_Directory) / fmt::format("{0:016x}.model", Hasher(CACHE_VERSION).Add(modelHash).Get())).u8string();
+}
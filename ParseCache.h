@@ -0,0 +1,43 @@
+#pragma once
+#include "SourceData.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// On-disk cache of everything the conversion reads from a world LVL (layers, instances, terrain,
+// models and textures), so converting the same map again, e.g. with other options, skips LibSWBF2.
+// Each entry is a single flat file, named after the hash of the world LVL and the common LVL
+// content. It gets memory mapped and used in place, nothing gets copied when reading it.
+class ParseCache
+{
+public:
+    // 'commonLVL' is the common LVL (e.g. ingame.lvl) all world LVLs get converted with, may be empty
+    ParseCache(const std::string& directory, const std::string& commonLVL);
+
+    bool IsEnabled() const;
+
+    // Hashes the whole content of 'worldLVL'
+    uint64_t GetKey(const std::string& worldLVL) const;
+
+    // Returns nullptr on a miss. Entries without textures only count if no textures are needed.
+    std::unique_ptr<SourceScene> Load(uint64_t key, bool bTextures) const;
+
+    // Stores all layers of 'scene', along with every model (and with 'bTextures', every texture) they use
+    bool Store(uint64_t key, const SourceScene& scene, bool bTextures) const;
+
+    // Models get cached on their own as well, keyed by the hash of their raw chunk (see hashModels()), so a
+    // changed world LVL only needs the models which actually changed loaded again. Returns a scene holding
+    // every model of 'modelHashes' found in the cache and puts their names into 'outNames', or nullptr if none is.
+    std::unique_ptr<SourceScene> LoadModels(const std::unordered_map<std::string, uint64_t>& modelHashes, std::unordered_set<std::string>& outNames) const;
+
+    // Stores every model of 'modelHashes' the layers of 'scene' use, unless already cached
+    void StoreModels(const std::unordered_map<std::string, uint64_t>& modelHashes, const SourceScene& scene) const;
+
+private:
+    std::string GetPath(uint64_t key) const;
+    std::string GetModelPath(uint64_t modelHash) const;
+
+    std::string m_Directory;
+    uint64_t m_CommonKey = 0;
+};
@@ -0,0 +1,831 @@
+#include "Platform.h"
+#include <cstdio>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "Psapi.lib")
+#pragma comment(lib, "Ws2_32.lib")
+#define closeSocket closesocket
+#define pollSockets WSAPoll
+#define SHUTDOWN_BOTH SD_BOTH
+typedef WSAPOLLFD SocketPollFd;
+#define SEND_FLAGS 0
+typedef int socklen_t;
+typedef SOCKET NativeSocket;
+#else
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+extern char** environ;
+#define closeSocket close
+#define pollSockets poll
+typedef int NativeSocket;
+typedef pollfd SocketPollFd;
+#define SHUTDOWN_BOTH SHUT_RDWR
+#ifdef MSG_NOSIGNAL
+// a client hanging up must not kill the whole process with SIGPIPE
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+#endif
+
+static bool initSockets()
+{
+#ifdef _WIN32
+    static const bool bInitialized = []()
+    {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return bInitialized;
+#else
+    return true;
+#endif
+}
+
+
+uint64_t getResidentMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#else
+    // second field is the resident set, in pages
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == nullptr)
+    {
+        return 0;
+    }
+    unsigned long long pages = 0;
+    int numRead = fscanf(statm, "%*u %llu", &pages);
+    fclose(statm);
+    return numRead == 1 ? pages * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+uint64_t getPeakResidentMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;
+#else
+    // kilobytes everywhere else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+
+std::string getExecutablePath()
+{
+#ifdef _WIN32
+    std::wstring path(MAX_PATH, L'\0');
+    DWORD length = 0;
+    while ((length = GetModuleFileNameW(nullptr, path.data(), (DWORD)path.size())) == path.size())
+    {
+        path.resize(path.size() * 2);
+    }
+    path.resize(length);
+    return std::filesystem::path(path).u8string();
+#elif defined(__APPLE__)
+    char path[4096];
+    uint32_t size = sizeof(path);
+    return _NSGetExecutablePath(path, &size) == 0 ? std::string(path) : std::string();
+#else
+    std::error_code err;
+    std::filesystem::path path = std::filesystem::read_symlink("/proc/self/exe", err);
+    return err ? std::string() : path.u8string();
+#endif
+}
+
+
+ChildProcess::~ChildProcess()
+{
+    // don't leave a zombie behind
+    if (m_Handle != -1)
+    {
+        Kill();
+        Wait();
+    }
+}
+
+bool ChildProcess::Start(const std::string& executable, const std::vector<std::string>& args, const std::string& logFile)
+{
+#ifdef _WIN32
+    // every argument quoted, with embedded quotes and the backslashes preceding them escaped
+    std::wstring commandLine;
+    auto appendArg = [&commandLine](const std::string& arg)
+    {
+        std::wstring wide = std::filesystem::u8path(arg).wstring();
+        commandLine += commandLine.empty() ? L"\"" : L" \"";
+        size_t numBackslashes = 0;
+        for (wchar_t c : wide)
+        {
+            if (c == L'\\')
+            {
+                numBackslashes++;
+                continue;
+            }
+            commandLine.append(c == L'"' ? numBackslashes * 2 + 1 : numBackslashes, L'\\');
+            commandLine += c;
+            numBackslashes = 0;
+        }
+        commandLine.append(numBackslashes * 2, L'\\');
+        commandLine += L'"';
+    };
+    appendArg(executable);
+    for (const std::string& arg : args)
+    {
+        appendArg(arg);
+    }
+
+    SECURITY_ATTRIBUTES security = { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+    HANDLE log = CreateFileW(std::filesystem::u8path(logFile).c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        &security, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (log == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    STARTUPINFOW startup = {};
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    startup.hStdOutput = log;
+    startup.hStdError = log;
+    PROCESS_INFORMATION info = {};
+    BOOL bStarted = CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, &info);
+    CloseHandle(log);
+    if (!bStarted)
+    {
+        return false;
+    }
+    CloseHandle(info.hThread);
+    m_Handle = (intptr_t)info.hProcess;
+    return true;
+#else
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(executable.c_str()));
+    for (const std::string& arg : args)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, logFile.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    pid_t pid = -1;
+    int result = posix_spawn(&pid, executable.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (result != 0)
+    {
+        return false;
+    }
+    m_Handle = (intptr_t)pid;
+    return true;
+#endif
+}
+
+bool ChildProcess::IsRunning()
+{
+    if (m_Handle == -1)
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return WaitForSingleObject((HANDLE)m_Handle, 0) == WAIT_TIMEOUT;
+#else
+    // once reaped, the exit code is gone, but nobody asks for it after this
+    int status = 0;
+    if (waitpid((pid_t)m_Handle, &status, WNOHANG) == 0)
+    {
+        return true;
+    }
+    m_Handle = -1;
+    return false;
+#endif
+}
+
+int ChildProcess::Wait()
+{
+    if (m_Handle == -1)
+    {
+        return -1;
+    }
+#ifdef _WIN32
+    DWORD exitCode = (DWORD)-1;
+    WaitForSingleObject((HANDLE)m_Handle, INFINITE);
+    GetExitCodeProcess((HANDLE)m_Handle, &exitCode);
+    CloseHandle((HANDLE)m_Handle);
+    m_Handle = -1;
+    return (int)exitCode;
+#else
+    int status = 0;
+    pid_t result = waitpid((pid_t)m_Handle, &status, 0);
+    m_Handle = -1;
+    return result != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+void ChildProcess::Kill()
+{
+    if (m_Handle == -1)
+    {
+        return;
+    }
+#ifdef _WIN32
+    TerminateProcess((HANDLE)m_Handle, 1);
+#else
+    kill((pid_t)m_Handle, SIGKILL);
+#endif
+}
+
+
+// A socket file nobody accepts connections on anymore
+static bool isStaleSocket(const std::string& path)
+{
+#ifdef _WIN32
+#ifndef IO_REPARSE_TAG_AF_UNIX
+    constexpr DWORD IO_REPARSE_TAG_AF_UNIX = 0x80000023;
+#endif
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileW(std::filesystem::u8path(path).c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    FindClose(find);
+    const bool bSocket = (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 && data.dwReserved0 == IO_REPARSE_TAG_AF_UNIX;
+#else
+    struct stat info;
+    const bool bSocket = lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode);
+#endif
+    LocalSocket probe;
+    return bSocket && !probe.Connect(path);
+}
+
+
+LocalSocket::~LocalSocket()
+{
+    Close();
+}
+
+LocalSocket::LocalSocket(LocalSocket&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+LocalSocket& LocalSocket::operator=(LocalSocket&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_Handle = other.m_Handle;
+        m_Received = std::move(other.m_Received);
+        m_BoundPath = std::move(other.m_BoundPath);
+        other.m_Handle = -1;
+        other.m_BoundPath.clear();
+    }
+    return *this;
+}
+
+bool LocalSocket::Listen(const std::string& path)
+{
+    Close();
+
+    sockaddr_un addr = {};
+    if (!initSockets() || path.size() >= sizeof(addr.sun_path))
+    {
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    // a previous instance that didn't shut down cleanly leaves its socket file behind. Nothing else gets removed
+    std::error_code err;
+    if (std::filesystem::symlink_status(path, err).type() != std::filesystem::file_type::not_found)
+    {
+        if (!isStaleSocket(path))
+        {
+            return false;
+        }
+#ifdef _WIN32
+        DeleteFileA(path.c_str());
+#else
+        unlink(path.c_str());
+#endif
+    }
+
+    m_Handle = (intptr_t)socket(AF_UNIX, SOCK_STREAM, 0);
+    if (!IsOpen())
+    {
+        return false;
+    }
+
+    if (bind((NativeSocket)m_Handle, reinterpret_cast<sockaddr*>(&addr), (socklen_t)sizeof(addr)) != 0 || listen((NativeSocket)m_Handle, 16) != 0)
+    {
+        Close();
+        return false;
+    }
+    m_BoundPath = path;
+    return true;
+}
+
+bool LocalSocket::Accept(LocalSocket& outClient, uint32_t timeoutMs, bool& outTimedOut)
+{
+    SocketPollFd fd = {};
+    fd.fd = (NativeSocket)m_Handle;
+    fd.events = POLLIN;
+    const int numReady = pollSockets(&fd, 1, (int)std::min<uint32_t>(timeoutMs, INT32_MAX));
+    outTimedOut = numReady == 0;
+    if (numReady != 1 || (fd.revents & POLLIN) == 0)
+    {
+        return false;
+    }
+
+    intptr_t client = (intptr_t)accept((NativeSocket)m_Handle, nullptr, nullptr);
+    if (client == -1)
+    {
+        return false;
+    }
+    outClient.Close();
+    outClient.m_Handle = client;
+    return true;
+}
+
+bool LocalSocket::Connect(const std::string& path)
+{
+    Close();
+
+    sockaddr_un addr = {};
+    if (!initSockets() || path.size() >= sizeof(addr.sun_path))
+    {
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    m_Handle = (intptr_t)socket(AF_UNIX, SOCK_STREAM, 0);
+    if (!IsOpen())
+    {
+        return false;
+    }
+    if (connect((NativeSocket)m_Handle, reinterpret_cast<sockaddr*>(&addr), (socklen_t)sizeof(addr)) != 0)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool LocalSocket::ReadLine(std::string& outLine)
+{
+    while (true)
+    {
+        size_t end = m_Received.find('\n');
+        if (end != std::string::npos)
+        {
+            outLine = m_Received.substr(0, end);
+            m_Received.erase(0, end + 1);
+            if (!outLine.empty() && outLine.back() == '\r')
+            {
+                outLine.pop_back();
+            }
+            return true;
+        }
+
+        char chunk[4096];
+        int count = (int)recv((NativeSocket)m_Handle, chunk, (int)sizeof(chunk), 0);
+        if (count <= 0)
+        {
+            return false;
+        }
+        m_Received.append(chunk, count);
+    }
+}
+
+bool LocalSocket::WriteLine(const std::string& line)
+{
+    std::string data = line + '\n';
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        int count = (int)send((NativeSocket)m_Handle, data.data() + sent, (int)(data.size() - sent), SEND_FLAGS);
+        if (count <= 0)
+        {
+            return false;
+        }
+        sent += count;
+    }
+    return true;
+}
+
+void LocalSocket::Shutdown()
+{
+    if (IsOpen())
+    {
+        shutdown((NativeSocket)m_Handle, SHUTDOWN_BOTH);
+    }
+}
+
+void LocalSocket::Close()
+{
+    if (IsOpen())
+    {
+        closeSocket((NativeSocket)m_Handle);
+        m_Handle = -1;
+    }
+    if (!m_BoundPath.empty())
+    {
+#ifdef _WIN32
+        DeleteFileA(m_BoundPath.c_str());
+#else
+        unlink(m_BoundPath.c_str());
+#endif
+        m_BoundPath.clear();
+    }
+    m_Received.clear();
+}
+
+bool LocalSocket::IsOpen() const
+{
+    return m_Handle != -1;
+}
+
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(std::filesystem::u8path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+    // the view keeps the mapping alive
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr)
+    {
+        return false;
+    }
+    m_Size = (size_t)size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    // the mapping stays valid after closing the descriptor
+    void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+    m_Size = (size_t)info.st_size;
+#endif
+
+    m_Data = static_cast<const uint8_t*>(view);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (!IsOpen())
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(m_Data);
+#else
+    munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+    return m_Data != nullptr;
+}
+
+void MappedFile::Prefetch() const
+{
+    if (!IsOpen())
+    {
+        return;
+    }
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range = { const_cast<uint8_t*>(m_Data), m_Size };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    madvise(const_cast<uint8_t*>(m_Data), m_Size, MADV_WILLNEED);
+#endif
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+    return m_Data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return m_Size;
+}
+
+
+struct FileWatcher::Directory
+{
+    std::string m_Path;
+#ifdef _WIN32
+    HANDLE m_Handle = INVALID_HANDLE_VALUE;
+    OVERLAPPED m_Overlapped = {};
+    alignas(DWORD) uint8_t m_Buffer[64 * 1024];
+
+    bool Listen()
+    {
+        return ReadDirectoryChangesW(m_Handle, m_Buffer, (DWORD)sizeof(m_Buffer), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE, nullptr, &m_Overlapped, nullptr) != FALSE;
+    }
+#else
+    int m_Watch = -1;
+#endif
+};
+
+FileWatcher::FileWatcher()
+{
+#ifndef _WIN32
+    m_Handle = (intptr_t)inotify_init1(IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef _WIN32
+    for (std::unique_ptr<Directory>& dir : m_Directories)
+    {
+        // the pending read has to be done before its buffer goes away
+        CancelIoEx(dir->m_Handle, &dir->m_Overlapped);
+        DWORD numBytes;
+        GetOverlappedResult(dir->m_Handle, &dir->m_Overlapped, &numBytes, TRUE);
+        CloseHandle(dir->m_Handle);
+        CloseHandle(dir->m_Overlapped.hEvent);
+    }
+#else
+    if (m_Handle != -1)
+    {
+        close((int)m_Handle);
+    }
+#endif
+}
+
+bool FileWatcher::Watch(const std::string& path)
+{
+    std::filesystem::path file = std::filesystem::u8path(path);
+    std::filesystem::path dirPath = file.parent_path();
+    if (dirPath.empty())
+    {
+        dirPath = ".";
+    }
+
+    WatchedFile watched;
+    watched.m_Path = path;
+    watched.m_Name = file.filename().u8string();
+    watched.m_Directory = m_Directories.size();
+    for (size_t i = 0; i < m_Directories.size(); ++i)
+    {
+        if (m_Directories[i]->m_Path == dirPath.u8string())
+        {
+            watched.m_Directory = i;
+        }
+    }
+
+    if (watched.m_Directory == m_Directories.size())
+    {
+        std::unique_ptr<Directory> dir = std::make_unique<Directory>();
+        dir->m_Path = dirPath.u8string();
+#ifdef _WIN32
+        dir->m_Handle = CreateFileW(dirPath.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (dir->m_Handle == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        dir->m_Overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (dir->m_Overlapped.hEvent == nullptr || !dir->Listen())
+        {
+            CloseHandle(dir->m_Handle);
+            if (dir->m_Overlapped.hEvent != nullptr)
+            {
+                CloseHandle(dir->m_Overlapped.hEvent);
+            }
+            return false;
+        }
+#else
+        if (m_Handle == -1)
+        {
+            return false;
+        }
+        dir->m_Watch = inotify_add_watch((int)m_Handle, dir->m_Path.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE);
+        if (dir->m_Watch == -1)
+        {
+            return false;
+        }
+#endif
+        m_Directories.push_back(std::move(dir));
+    }
+    m_Files.push_back(watched);
+    return true;
+}
+
+EWatchResult FileWatcher::Wait(uint32_t timeoutMs, std::vector<std::string>& outChanged)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (true)
+    {
+        uint32_t remainingMs = UINT32_MAX;
+        if (timeoutMs != UINT32_MAX)
+        {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            remainingMs = (uint32_t)std::max<int64_t>(remaining.count(), 0);
+        }
+        EWatchResult result = WaitOnce(remainingMs, outChanged);
+        if (result != EWatchResult::TimedOut || remainingMs == 0 || std::chrono::steady_clock::now() >= deadline)
+        {
+            return result;
+        }
+    }
+}
+
+EWatchResult FileWatcher::WaitOnce(uint32_t timeoutMs, std::vector<std::string>& outChanged)
+{
+    const size_t numChanged = outChanged.size();
+    auto reportChange = [&](size_t dirIdx, const std::string& name)
+    {
+        for (const WatchedFile& file : m_Files)
+        {
+#ifdef _WIN32
+            const bool bSameName = _stricmp(name.c_str(), file.m_Name.c_str()) == 0;
+#else
+            const bool bSameName = name == file.m_Name;
+#endif
+            // an empty name means anything in that directory might have changed
+            if (file.m_Directory == dirIdx && (name.empty() || bSameName) && std::find(outChanged.begin(), outChanged.end(), file.m_Path) == outChanged.end())
+            {
+                outChanged.push_back(file.m_Path);
+            }
+        }
+    };
+
+#ifdef _WIN32
+    std::vector<HANDLE> events;
+    for (const std::unique_ptr<Directory>& dir : m_Directories)
+    {
+        events.push_back(dir->m_Overlapped.hEvent);
+    }
+    if (events.empty())
+    {
+        return EWatchResult::Failed;
+    }
+
+    DWORD result = WaitForMultipleObjects((DWORD)events.size(), events.data(), FALSE, timeoutMs == UINT32_MAX ? INFINITE : timeoutMs);
+    if (result == WAIT_TIMEOUT)
+    {
+        return EWatchResult::TimedOut;
+    }
+    if (result < WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + events.size())
+    {
+        return EWatchResult::Failed;
+    }
+
+    // other directories may have been signaled at the same time
+    for (size_t i = 0; i < m_Directories.size(); ++i)
+    {
+        Directory& dir = *m_Directories[i];
+        DWORD numBytes = 0;
+        if (WaitForSingleObject(dir.m_Overlapped.hEvent, 0) != WAIT_OBJECT_0)
+        {
+            continue;
+        }
+        if (!GetOverlappedResult(dir.m_Handle, &dir.m_Overlapped, &numBytes, FALSE) || numBytes == 0)
+        {
+            // the buffer overflowed, so changes got lost
+            reportChange(i, "");
+        }
+        for (DWORD offset = 0; numBytes > 0;)
+        {
+            const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(dir.m_Buffer + offset);
+            if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME)
+            {
+                reportChange(i, std::filesystem::path(std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR))).u8string());
+            }
+            if (info->NextEntryOffset == 0)
+            {
+                break;
+            }
+            offset += info->NextEntryOffset;
+        }
+        ResetEvent(dir.m_Overlapped.hEvent);
+        if (!dir.Listen())
+        {
+            return EWatchResult::Failed;
+        }
+    }
+#else
+    if (m_Handle == -1)
+    {
+        return EWatchResult::Failed;
+    }
+    pollfd fd = { (int)m_Handle, POLLIN, 0 };
+    const int numReady = poll(&fd, 1, timeoutMs == UINT32_MAX ? -1 : (int)std::min<uint32_t>(timeoutMs, INT32_MAX));
+    if (numReady == 0 || (numReady < 0 && errno == EINTR))
+    {
+        return EWatchResult::TimedOut;
+    }
+    if (numReady < 0 || (fd.revents & (POLLERR | POLLNVAL)) != 0)
+    {
+        return EWatchResult::Failed;
+    }
+
+    alignas(inotify_event) char buffer[64 * 1024];
+    ssize_t numBytes = read((int)m_Handle, buffer, sizeof(buffer));
+    if (numBytes < 0)
+    {
+        return errno == EINTR || errno == EAGAIN ? EWatchResult::TimedOut : EWatchResult::Failed;
+    }
+    for (ssize_t offset = 0; offset < numBytes;)
+    {
+        const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+        for (size_t i = 0; i < m_Directories.size(); ++i)
+        {
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                reportChange(i, "");
+            }
+            else if (m_Directories[i]->m_Watch == event->wd && event->len > 0)
+            {
+                reportChange(i, event->name);
+            }
+        }
+        offset += sizeof(inotify_event) + event->len;
+    }
+#endif
+    return outChanged.size() > numChanged ? EWatchResult::Changed : EWatchResult::TimedOut;
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Resident memory (working set) of this process right now and at its peak, in bytes. 0 if unknown.
+uint64_t getResidentMemory();
+uint64_t getPeakResidentMemory();
+
+// Full path of the running executable. Empty if unknown.
+std::string getExecutablePath();
+
+// A process started from an executable, with its output going into a log file
+class ChildProcess
+{
+public:
+    ChildProcess() = default;
+    ~ChildProcess();
+
+    ChildProcess(const ChildProcess&) = delete;
+    ChildProcess& operator=(const ChildProcess&) = delete;
+
+    // 'args' excludes the executable itself. Standard output and error get appended to 'logFile'.
+    bool Start(const std::string& executable, const std::vector<std::string>& args, const std::string& logFile);
+    bool IsRunning();
+
+    // Blocks until the process exits and returns its exit code, -1 if it didn't exit normally
+    int Wait();
+    void Kill();
+
+private:
+    // process HANDLE on Windows, pid otherwise
+    intptr_t m_Handle = -1;
+};
+
+// Stream socket bound to a local path (AF_UNIX). Available on POSIX systems and Windows 10 1803 and newer.
+class LocalSocket
+{
+public:
+    LocalSocket() = default;
+    ~LocalSocket();
+
+    LocalSocket(const LocalSocket&) = delete;
+    LocalSocket& operator=(const LocalSocket&) = delete;
+    LocalSocket(LocalSocket&& other) noexcept;
+    LocalSocket& operator=(LocalSocket&& other) noexcept;
+
+    // Replaces a stale socket file at 'path', left behind by an instance that didn't shut down cleanly.
+    // Fails if 'path' is anything else, e.g. a regular file or the socket of an instance still running.
+    bool Listen(const std::string& path);
+
+    // Waits at most 'timeoutMs' for a connection. Returns false on a timeout as well as on errors, 'outTimedOut' tells them apart.
+    // Nothing portably wakes up a thread blocking in accept() (Winsock ignores shutdown() of listening sockets),
+    // so servers wait with a timeout and check whether to stop in between.
+    bool Accept(LocalSocket& outClient, uint32_t timeoutMs, bool& outTimedOut);
+    bool Connect(const std::string& path);
+
+    // Lines are separated by '\n', which is not part of 'outLine'
+    bool ReadLine(std::string& outLine);
+    bool WriteLine(const std::string& line);
+
+    // Ends a connection in both directions, so ReadLine() on either end returns false.
+    // Doesn't wake up Accept(), see there.
+    void Shutdown();
+    void Close();
+    bool IsOpen() const;
+
+private:
+    // SOCKET on Windows, file descriptor otherwise
+    intptr_t m_Handle = -1;
+    std::string m_Received;
+    std::string m_BoundPath;
+};
+
+// Read only view of a whole file, mapped into memory. Pages only get read from disk when touched,
+// so looking at a few headers of a large file is cheap.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Fails for empty files, there's nothing to map
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const;
+
+    // Asks the OS to read the whole file into the page cache in the background. Whoever
+    // reads the file next, no matter how or in which process, finds it in memory then.
+    void Prefetch() const;
+
+    const uint8_t* GetData() const;
+    size_t GetSize() const;
+
+private:
+    const uint8_t* m_Data = nullptr;
+    size_t m_Size = 0;
+};
+
+enum class EWatchResult
+{
+    Changed,
+    TimedOut,
+    Failed
+};
+
+// Reports writes to a set of files (inotify on Linux, ReadDirectoryChangesW on Windows). Watches their
+// directories rather than the files themselves, so files which get replaced instead of overwritten
+// (e.g. written to a temp file and renamed) keep getting reported.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool Watch(const std::string& path);
+
+    // Blocks until a watched file changed or 'timeoutMs' passed, and adds the changed files (as passed
+    // to Watch()) to 'outChanged', each once. Changes of other files in the same directories don't count.
+    // UINT32_MAX waits forever. An interrupting signal counts as timeout, so the caller can check for it.
+    EWatchResult Wait(uint32_t timeoutMs, std::vector<std::string>& outChanged);
+
+private:
+    struct Directory;
+
+    // A single round of waiting, which may end early on changes of files not watched
+    EWatchResult WaitOnce(uint32_t timeoutMs, std::vector<std::string>& outChanged);
+
+    struct WatchedFile
+    {
+        std::string m_Path;
+        std::string m_Name;
+        size_t m_Directory = 0;
+    };
+
+    // inotify instance, unused on Windows
+    intptr_t m_Handle = -1;
+    std::vector<WatchedFile> m_Files;
+    std::vector<std::unique_ptr<Directory>> m_Directories;
+};
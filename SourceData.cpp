@@ -0,0 +1,291 @@
+#include "SourceData.h"
+#include <algorithm>
+
+
+static std::string toLower(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(), [](char c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; });
+    return str;
+}
+
+// LibSWBF2 converts data on demand (e.g. decodes textures) into buffers of its own, which isn't safe
+// to do from several threads at once. Scenes share the common LVLs (e.g. in a batch), so one lock for all of them.
+// All reading from LibSWBF2 happens in here, everything else only reads the views handed out.
+static std::mutex s_LibSWBF2Mutex;
+
+template<class Func>
+static auto withLibSWBF2(Func&& func)
+{
+    std::lock_guard<std::mutex> lock(s_LibSWBF2Mutex);
+    return func();
+}
+
+
+bool SourceTexture::GetImageData(uint8_t mipLevel, uint16_t& outWidth, uint16_t& outHeight, const uint8_t*& outData) const
+{
+    if (m_Texture != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(s_LibSWBF2Mutex);
+        if (mipLevel >= m_Decoded.size())
+        {
+            m_Decoded.resize(mipLevel + 1);
+        }
+
+        // the decoded data gets copied, so it stays valid whatever LibSWBF2 decodes next
+        Decoded& decoded = m_Decoded[mipLevel];
+        if (!decoded.m_bTried)
+        {
+            decoded.m_bTried = true;
+            const uint8_t* data = nullptr;
+            decoded.m_bValid = m_Texture->GetImageData(ETextureFormat::R8_G8_B8_A8, mipLevel, decoded.m_Width, decoded.m_Height, data);
+            if (decoded.m_bValid && data != nullptr)
+            {
+                decoded.m_RGBA.assign(data, data + (size_t)decoded.m_Width * decoded.m_Height * 4);
+            }
+        }
+        outWidth = decoded.m_Width;
+        outHeight = decoded.m_Height;
+        outData = decoded.m_RGBA.empty() ? nullptr : decoded.m_RGBA.data();
+        return decoded.m_bValid;
+    }
+    if (mipLevel >= m_Mips.size())
+    {
+        return false;
+    }
+    outWidth = m_Mips[mipLevel].m_Width;
+    outHeight = m_Mips[mipLevel].m_Height;
+    outData = m_Mips[mipLevel].m_RGBA;
+    return true;
+}
+
+
+SourceScene::SourceScene(const Level* world, const Container* common, std::unique_ptr<SourceScene> cachedModels) :
+    m_World(world),
+    m_Common(common),
+    m_CachedModels(std::move(cachedModels))
+{
+    if (m_World == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(s_LibSWBF2Mutex);
+    const List<World>& worlds = m_World->GetWorlds();
+    m_Layers.resize(worlds.Size());
+    for (uint32_t i = 0; i < worlds.Size(); ++i)
+    {
+        const World& wld = worlds[i];
+        SourceLayer& layer = m_Layers[i];
+        layer.m_Name = wld.GetName().Buffer();
+
+        List<Instance> insts = wld.GetInstances();
+        layer.m_Instances.resize(insts.Size());
+        for (uint32_t j = 0; j < insts.Size(); ++j)
+        {
+            SourceInstance& inst = layer.m_Instances[j];
+            inst.m_Name = insts[j].GetName().Buffer();
+            inst.m_Position = insts[j].GetPosition();
+            inst.m_Rotation = insts[j].GetRotation();
+
+            String geometryName;
+            if (insts[j].GetProperty("GeometryName", geometryName))
+            {
+                inst.m_Geometry = geometryName.Buffer();
+            }
+        }
+
+        const Terrain* terr = wld.GetTerrain();
+        if (terr == nullptr)
+        {
+            continue;
+        }
+
+        layer.m_Terrain = std::make_unique<SourceTerrain>();
+        SourceTerrain& terrain = *layer.m_Terrain;
+        terrain.m_Name = terr->GetName().Buffer();
+
+        Vector3* vertices = nullptr;
+        Vector3* normals = nullptr;
+        Vector2* uvs = nullptr;
+        uint16_t* indices = nullptr;
+        terr->GetVertexBuffer(terrain.m_NumVertices, vertices);
+        terr->GetNormalBuffer(terrain.m_NumNormals, normals);
+        terr->GetUVBuffer(terrain.m_NumUVs, uvs);
+        terr->GetIndexBuffer(ETopology::TriangleList, terrain.m_NumIndices, indices);
+        terrain.m_Vertices = vertices;
+        terrain.m_Normals = normals;
+        terrain.m_UVs = uvs;
+        terrain.m_Indices = indices;
+
+        uint8_t* blendMap = nullptr;
+        if (terr->GetBlendMap(terrain.m_BlendDim, terrain.m_NumLayers, blendMap))
+        {
+            terrain.m_BlendMap = blendMap;
+        }
+        else
+        {
+            terrain.m_BlendDim = 0;
+            terrain.m_NumLayers = 0;
+        }
+
+        const List<String>& layerTextures = terr->GetLayerTextures();
+        for (uint32_t j = 0; j < layerTextures.Size(); ++j)
+        {
+            terrain.m_LayerTextures.emplace_back(layerTextures[j].Buffer());
+        }
+    }
+}
+
+const std::vector<SourceLayer>& SourceScene::GetLayers() const
+{
+    return m_Layers;
+}
+
+const SourceModel* SourceScene::FindModel(const std::string& name) const
+{
+    return FindModel(name, false);
+}
+
+const SourceModel* SourceScene::FindWorldModel(const std::string& name) const
+{
+    return FindModel(name, true);
+}
+
+const SourceModel* SourceScene::FindModel(const std::string& name, bool bWorldOnly) const
+{
+    const std::string key = toLower(name);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto it = m_Models.find(key);
+    if (it != m_Models.end())
+    {
+        return !bWorldOnly || it->second->m_bWorld ? it->second.get() : nullptr;
+    }
+
+    const Model* model = m_World != nullptr ? withLibSWBF2([&]() { return m_World->GetModel(name.c_str()); }) : nullptr;
+    if (model != nullptr)
+    {
+        return AddModel(key, *model, true);
+    }
+    if (m_CachedModels != nullptr)
+    {
+        const SourceModel* cached = m_CachedModels->FindModel(name);
+        if (cached != nullptr)
+        {
+            return AddModel(key, *cached, bWorldOnly);
+        }
+    }
+    if (!bWorldOnly && m_Common != nullptr)
+    {
+        model = withLibSWBF2([&]() { return m_Common->FindModel(name.c_str()); });
+    }
+    return model != nullptr ? AddModel(key, *model, false) : nullptr;
+}
+
+const SourceTexture* SourceScene::FindTexture(const std::string& name) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return LookupTexture(name, false);
+}
+
+const SourceTexture* SourceScene::LookupTexture(const std::string& name, bool bWorldOnly) const
+{
+    const std::string key = toLower(name);
+    auto it = m_TexturesByName.find(key);
+    if (it != m_TexturesByName.end())
+    {
+        return it->second;
+    }
+
+    const Texture* texture = m_World != nullptr ? withLibSWBF2([&]() { return m_World->GetTexture(name.c_str()); }) : nullptr;
+    if (texture == nullptr && !bWorldOnly && m_Common != nullptr)
+    {
+        texture = withLibSWBF2([&]() { return m_Common->FindTexture(name.c_str()); });
+    }
+    if (texture == nullptr)
+    {
+        return nullptr;
+    }
+
+    const SourceTexture* source = withLibSWBF2([&]() { return AddTexture(texture); });
+    m_TexturesByName[key] = source;
+    return source;
+}
+
+const SourceModel* SourceScene::AddModel(const std::string& key, const Model& model, bool bWorld) const
+{
+    std::lock_guard<std::mutex> lock(s_LibSWBF2Mutex);
+    std::unique_ptr<SourceModel>& source = m_Models[key];
+    source = std::make_unique<SourceModel>();
+    source->m_Name = model.GetName().Buffer();
+    source->m_bWorld = bWorld;
+
+    const List<Segment>& segments = model.GetSegments();
+    source->m_Segments.resize(segments.Size());
+    for (uint32_t k = 0; k < segments.Size(); ++k)
+    {
+        const Segment& segm = segments[k];
+        SourceSegment& seg = source->m_Segments[k];
+
+        Vector3* vertices = nullptr;
+        Vector3* normals = nullptr;
+        Vector2* uvs = nullptr;
+        uint16_t* indices = nullptr;
+        segm.GetVertexBuffer(seg.m_NumVertices, vertices);
+        segm.GetNormalBuffer(seg.m_NumNormals, normals);
+        segm.GetUVBuffer(seg.m_NumUVs, uvs);
+        segm.GetIndexBuffer(seg.m_NumIndices, indices);
+        seg.m_Vertices = vertices;
+        seg.m_Normals = normals;
+        seg.m_UVs = uvs;
+        seg.m_Indices = indices;
+        seg.m_Topology = segm.GetTopology();
+
+        const Material& mat = segm.GetMaterial();
+        seg.m_DiffuseColor = mat.GetDiffuseColor();
+        const Texture* texture = mat.GetTexture(0);
+        seg.m_Texture = texture != nullptr ? AddTexture(texture) : nullptr;
+    }
+    return source.get();
+}
+
+const SourceModel* SourceScene::AddModel(const std::string& key, const SourceModel& cached, bool bWorldOnly) const
+{
+    // textures of other LVLs (e.g. ingame.lvl) may not be loaded yet. Instead of keeping the model without
+    // them for good, it's left to a full lookup, which happens once everything is loaded
+    std::vector<const SourceTexture*> textures;
+    for (const SourceSegment& seg : cached.m_Segments)
+    {
+        const SourceTexture* texture = seg.m_Texture != nullptr ? LookupTexture(seg.m_Texture->m_Name, bWorldOnly) : nullptr;
+        if (bWorldOnly && seg.m_Texture != nullptr && texture == nullptr)
+        {
+            return nullptr;
+        }
+        textures.push_back(texture);
+    }
+
+    std::unique_ptr<SourceModel>& source = m_Models[key];
+    source = std::make_unique<SourceModel>(cached);
+    source->m_bWorld = true;
+    for (size_t i = 0; i < source->m_Segments.size(); ++i)
+    {
+        source->m_Segments[i].m_Texture = textures[i];
+    }
+    return source.get();
+}
+
+const SourceTexture* SourceScene::AddTexture(const Texture* texture) const
+{
+    auto it = m_TexturesBySource.find(texture);
+    if (it != m_TexturesBySource.end())
+    {
+        return it->second;
+    }
+
+    SourceTexture* source = m_Textures.emplace_back(std::make_unique<SourceTexture>()).get();
+    source->m_Name = texture->GetName().Buffer();
+    source->m_Texture = texture;
+    m_TexturesBySource[texture] = source;
+    m_TexturesByName.emplace(toLower(source->m_Name), source);
+    return source;
+}
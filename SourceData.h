@@ -0,0 +1,153 @@
+#pragma once
+#include "Common.h"
+#include "Platform.h"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Everything the conversion reads from the LVLs, as plain views. The data itself is owned
+// either by LibSWBF2 or by a memory mapped parse cache file (see ParseCache.h).
+
+struct SourceTexture
+{
+    struct Mip
+    {
+        uint16_t m_Width = 0;
+        uint16_t m_Height = 0;
+        const uint8_t* m_RGBA = nullptr;
+    };
+
+    std::string m_Name;
+
+    // decoded on demand by LibSWBF2 if set, read from 'm_Mips' otherwise
+    const Texture* m_Texture = nullptr;
+    std::vector<Mip> m_Mips;
+
+    // RGBA data of the given mip level, 0 being the largest. Returns false if there is no such level.
+    // Thread safe. Every level gets decoded only once, into memory of its own that stays valid for as long as the texture.
+    bool GetImageData(uint8_t mipLevel, uint16_t& outWidth, uint16_t& outHeight, const uint8_t*& outData) const;
+
+private:
+    struct Decoded
+    {
+        bool m_bTried = false;
+        bool m_bValid = false;
+        uint16_t m_Width = 0;
+        uint16_t m_Height = 0;
+        std::vector<uint8_t> m_RGBA;
+    };
+
+    // mip levels decoded by LibSWBF2 so far
+    mutable std::vector<Decoded> m_Decoded;
+};
+
+struct SourceSegment
+{
+    const Vector3* m_Vertices = nullptr;
+    uint32_t m_NumVertices = 0;
+    const Vector3* m_Normals = nullptr;
+    uint32_t m_NumNormals = 0;
+    const Vector2* m_UVs = nullptr;
+    uint32_t m_NumUVs = 0;
+    const uint16_t* m_Indices = nullptr;
+    uint32_t m_NumIndices = 0;
+    ETopology m_Topology = ETopology::TriangleList;
+
+    Color4u8 m_DiffuseColor = { 255, 255, 255, 255 };
+    const SourceTexture* m_Texture = nullptr;
+};
+
+struct SourceModel
+{
+    std::string m_Name;
+    std::vector<SourceSegment> m_Segments;
+
+    // found in the world LVL (or among its cached models) rather than in the common LVLs
+    bool m_bWorld = false;
+};
+
+struct SourceTerrain
+{
+    std::string m_Name;
+
+    // indices are a triangle list
+    const Vector3* m_Vertices = nullptr;
+    uint32_t m_NumVertices = 0;
+    const Vector3* m_Normals = nullptr;
+    uint32_t m_NumNormals = 0;
+    const Vector2* m_UVs = nullptr;
+    uint32_t m_NumUVs = 0;
+    const uint16_t* m_Indices = nullptr;
+    uint32_t m_NumIndices = 0;
+
+    // 'm_BlendDim' x 'm_BlendDim' texels with 'm_NumLayers' weights each. Null if there is no blend map
+    uint32_t m_BlendDim = 0;
+    uint32_t m_NumLayers = 0;
+    const uint8_t* m_BlendMap = nullptr;
+    std::vector<std::string> m_LayerTextures;
+};
+
+struct SourceInstance
+{
+    std::string m_Name;
+
+    // empty if the instance has no geometry
+    std::string m_Geometry;
+    Vector3 m_Position;
+    Vector4 m_Rotation;
+};
+
+struct SourceLayer
+{
+    std::string m_Name;
+    std::vector<SourceInstance> m_Instances;
+    std::unique_ptr<SourceTerrain> m_Terrain;
+};
+
+// The layers of a world and the models and textures they use. Resolves assets by name, looking
+// into the world LVL first, the cached models of the world LVL second and the common LVLs (e.g. ingame.lvl) last.
+// Lookups are thread safe and case insensitive, just like LibSWBF2's.
+class SourceScene
+{
+public:
+    // Reads from LibSWBF2, either of 'world' and 'common' may be null. The layers get read right away,
+    // models and textures on first use, so both have to stay loaded for as long as the scene gets used.
+    // The world LVL may be part of the container or loaded on its own. 'cachedModels' holds models left
+    // out of the world LVL, see ParseCache::LoadModels(). Their textures get looked up again by name.
+    SourceScene(const Level* world, const Container* common, std::unique_ptr<SourceScene> cachedModels = nullptr);
+
+    const std::vector<SourceLayer>& GetLayers() const;
+    const SourceModel* FindModel(const std::string& name) const;
+    const SourceTexture* FindTexture(const std::string& name) const;
+
+    // Only looks into the world LVL. Cached models using textures of other LVLs aren't found
+    const SourceModel* FindWorldModel(const std::string& name) const;
+
+private:
+    // filled in by the parse cache
+    friend class ParseCache;
+    SourceScene() = default;
+
+    const SourceModel* FindModel(const std::string& name, bool bWorldOnly) const;
+    const SourceModel* AddModel(const std::string& key, const Model& model, bool bWorld) const;
+    // Null if 'bWorldOnly' and a texture of the model isn't in the world LVL
+    const SourceModel* AddModel(const std::string& key, const SourceModel& cached, bool bWorldOnly) const;
+    // Reads from LibSWBF2, so the caller has to hold its lock (see SourceData.cpp)
+    const SourceTexture* AddTexture(const Texture* texture) const;
+    const SourceTexture* LookupTexture(const std::string& name, bool bWorldOnly) const;
+
+    const Level* m_World = nullptr;
+    const Container* m_Common = nullptr;
+    std::unique_ptr<SourceScene> m_CachedModels;
+    std::vector<SourceLayer> m_Layers;
+
+    // what got looked up so far, keyed by lower case name
+    mutable std::mutex m_Mutex;
+    mutable std::unordered_map<std::string, std::unique_ptr<SourceModel>> m_Models;
+    mutable std::unordered_map<std::string, const SourceTexture*> m_TexturesByName;
+    mutable std::unordered_map<const Texture*, const SourceTexture*> m_TexturesBySource;
+    mutable std::vector<std::unique_ptr<SourceTexture>> m_Textures;
+
+    // the parse cache files all views point into, if read from there
+    std::vector<std::unique_ptr<MappedFile>> m_CacheFiles;
+};
@@ -0,0 +1,135 @@
+#include "TaskPool.h"
+#include <algorithm>
+
+
+TaskPool::TaskPool(uint32_t numThreads)
+{
+    if (numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        m_Queues.emplace_back(std::make_unique<Queue>());
+    }
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        m_Threads.emplace_back(&TaskPool::WorkerLoop, this, i);
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_StateMutex);
+        m_bStop = true;
+    }
+    m_TaskAvailable.notify_all();
+    for (std::thread& thread : m_Threads)
+    {
+        thread.join();
+    }
+}
+
+void TaskPool::Submit(std::function<void()> task)
+{
+    m_NumPending++;
+
+    // spread new tasks round robin, stealing takes care of the rest
+    Queue& queue = *m_Queues[m_NextQueue++ % m_Queues.size()];
+    {
+        // counted under the same lock TryPop() uncounts it with, so the count never drops below 0
+        std::lock_guard<std::mutex> lock(queue.m_Mutex);
+        queue.m_Tasks.emplace_back(std::move(task));
+        m_NumQueued++;
+    }
+
+    {
+        // a worker checking for tasks right before the count went up is waiting by now, so it gets the notification
+        std::lock_guard<std::mutex> lock(m_StateMutex);
+    }
+    m_TaskAvailable.notify_one();
+}
+
+void TaskPool::Wait()
+{
+    WaitUntil([this]() { return m_NumPending == 0; });
+}
+
+uint32_t TaskPool::GetNumThreads() const
+{
+    return (uint32_t)m_Threads.size();
+}
+
+bool TaskPool::TryPop(uint32_t queueIdx, bool bSteal, std::function<void()>& outTask)
+{
+    Queue& queue = *m_Queues[queueIdx];
+    std::lock_guard<std::mutex> lock(queue.m_Mutex);
+    if (queue.m_Tasks.empty())
+    {
+        return false;
+    }
+
+    if (bSteal)
+    {
+        outTask = std::move(queue.m_Tasks.front());
+        queue.m_Tasks.pop_front();
+    }
+    else
+    {
+        outTask = std::move(queue.m_Tasks.back());
+        queue.m_Tasks.pop_back();
+    }
+    m_NumQueued--;
+    return true;
+}
+
+bool TaskPool::TryRunOne(uint32_t ownQueue)
+{
+    std::function<void()> task;
+    bool bFound = ownQueue != EXTERNAL_QUEUE && TryPop(ownQueue, false, task);
+
+    const uint32_t numQueues = (uint32_t)m_Queues.size();
+    const uint32_t start = ownQueue == EXTERNAL_QUEUE ? 0 : ownQueue + 1;
+    for (uint32_t i = 0; !bFound && i < numQueues; ++i)
+    {
+        uint32_t victim = (start + i) % numQueues;
+        if (victim != ownQueue)
+        {
+            bFound = TryPop(victim, true, task);
+        }
+    }
+
+    if (!bFound)
+    {
+        return false;
+    }
+
+    task();
+
+    {
+        std::lock_guard<std::mutex> lock(m_StateMutex);
+        m_NumPending--;
+    }
+    m_TaskFinished.notify_all();
+    return true;
+}
+
+void TaskPool::WorkerLoop(uint32_t queueIdx)
+{
+    while (true)
+    {
+        if (TryRunOne(queueIdx))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_StateMutex);
+        m_TaskAvailable.wait(lock, [this]() { return m_bStop || m_NumQueued > 0; });
+        if (m_bStop)
+        {
+            return;
+        }
+    }
+}
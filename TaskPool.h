@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing thread pool.
+// Every worker owns a task queue. It takes its own tasks from the back (LIFO, cache friendly)
+// and steals from the front of the other queues (FIFO) when running dry. Threads waiting
+// on the pool (Wait(), WaitUntil()) help executing tasks instead of blocking.
+class TaskPool
+{
+public:
+    // 0 = one worker per hardware thread
+    TaskPool(uint32_t numThreads = 0);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    void Submit(std::function<void()> task);
+
+    // Blocks until all submitted tasks have finished
+    void Wait();
+
+    // Blocks until 'isDone()' returns true. Gets re-evaluated every time a task finishes.
+    template<class Func>
+    void WaitUntil(Func isDone)
+    {
+        while (!isDone())
+        {
+            if (!TryRunOne(EXTERNAL_QUEUE))
+            {
+                std::unique_lock<std::mutex> lock(m_StateMutex);
+                m_TaskFinished.wait_for(lock, std::chrono::milliseconds(10));
+            }
+        }
+    }
+
+    uint32_t GetNumThreads() const;
+
+private:
+    static constexpr uint32_t EXTERNAL_QUEUE = UINT32_MAX;
+
+    struct Queue
+    {
+        std::mutex m_Mutex;
+        std::deque<std::function<void()>> m_Tasks;
+    };
+
+    bool TryPop(uint32_t queueIdx, bool bSteal, std::function<void()>& outTask);
+    bool TryRunOne(uint32_t ownQueue);
+    void WorkerLoop(uint32_t queueIdx);
+
+    std::vector<std::unique_ptr<Queue>> m_Queues;
+    std::vector<std::thread> m_Threads;
+
+    std::mutex m_StateMutex;
+    std::condition_variable m_TaskAvailable;
+    std::condition_variable m_TaskFinished;
+    std::atomic<uint32_t> m_NumQueued = 0;
+    std::atomic<uint32_t> m_NumPending = 0;
+    std::atomic<uint32_t> m_NextQueue = 0;
+    bool m_bStop = false;
+};
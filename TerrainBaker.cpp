@@ -0,0 +1,285 @@
+#include "TerrainBaker.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define LVL2GLTF_SSE2 1
+#include <emmintrin.h>
+#else
+#define LVL2GLTF_SSE2 0
+#endif
+
+// SWBF2 terrains have at most 16 texture layers
+constexpr uint32_t MAX_LAYERS = 16;
+
+// rows per parallel work item
+constexpr uint32_t ROW_BLOCK = 32;
+
+static const uint8_t WHITE_PIXEL[4] = { 255, 255, 255, 255 };
+
+
+void TerrainBaker::Bounds::Add(const Vector3& v)
+{
+    m_MinX = std::min(m_MinX, v.m_X);
+    m_MinZ = std::min(m_MinZ, v.m_Z);
+    m_MaxX = std::max(m_MaxX, v.m_X);
+    m_MaxZ = std::max(m_MaxZ, v.m_Z);
+}
+
+
+TerrainBaker::TerrainBaker(const SourceTerrain& terrain, const SourceScene& scene, const TerrainBakeOptions& options, TaskPool& pool) :
+    m_Terrain(terrain),
+    m_Scene(scene),
+    m_Options(options),
+    m_Pool(pool)
+{
+
+}
+
+bool TerrainBaker::Bake(std::vector<BakedTile>& outTiles)
+{
+    outTiles.clear();
+
+    if (m_Terrain.m_NumVertices == 0 || m_Terrain.m_NumIndices < 3)
+    {
+        return false;
+    }
+
+    if (m_Terrain.m_BlendMap == nullptr || m_Terrain.m_BlendDim == 0 || m_Terrain.m_NumLayers == 0)
+    {
+        LOG("Terrain '{0}' has no blend map, nothing to bake!", m_Terrain.m_Name.c_str());
+        return false;
+    }
+
+    const std::vector<std::string>& layerTextures = m_Terrain.m_LayerTextures;
+    m_Layers.resize(std::min(m_Terrain.m_NumLayers, MAX_LAYERS));
+    for (uint32_t i = 0; i < m_Layers.size(); ++i)
+    {
+        Layer& layer = m_Layers[i];
+        layer.m_RGBA = WHITE_PIXEL;
+
+        const SourceTexture* tex = i < layerTextures.size() ? m_Scene.FindTexture(layerTextures[i]) : nullptr;
+        if (tex == nullptr)
+        {
+            continue;
+        }
+        if (!tex->GetImageData(0, layer.m_Width, layer.m_Height, layer.m_RGBA))
+        {
+            LOG("Could not decode terrain layer texture '{0}'!", tex->m_Name.c_str());
+            layer = Layer();
+            layer.m_RGBA = WHITE_PIXEL;
+        }
+    }
+
+    // the layer textures repeat across the terrain the same way the
+    // terrain UVs do, so derive the world -> layer UV mapping from those
+    float minU = FLT_MAX, maxU = -FLT_MAX, minV = FLT_MAX, maxV = -FLT_MAX;
+    for (uint32_t i = 0; i < m_Terrain.m_NumVertices; ++i)
+    {
+        m_Bounds.Add(m_Terrain.m_Vertices[i]);
+        if (i < m_Terrain.m_NumUVs)
+        {
+            minU = std::min(minU, m_Terrain.m_UVs[i].m_X);
+            maxU = std::max(maxU, m_Terrain.m_UVs[i].m_X);
+            minV = std::min(minV, m_Terrain.m_UVs[i].m_Y);
+            maxV = std::max(maxV, m_Terrain.m_UVs[i].m_Y);
+        }
+    }
+
+    const float sizeX = std::max(m_Bounds.m_MaxX - m_Bounds.m_MinX, 1.0f);
+    const float sizeZ = std::max(m_Bounds.m_MaxZ - m_Bounds.m_MinZ, 1.0f);
+    if (m_Terrain.m_NumUVs > 0 && maxU > minU && maxV > minV)
+    {
+        m_LayerScaleU = (maxU - minU) / sizeX;
+        m_LayerOffsetU = minU - m_Bounds.m_MinX * m_LayerScaleU;
+        m_LayerScaleV = (maxV - minV) / sizeZ;
+        m_LayerOffsetV = minV - m_Bounds.m_MinZ * m_LayerScaleV;
+    }
+
+    std::vector<Bounds> tileBounds;
+    SplitGeometry(outTiles, tileBounds);
+
+    const uint32_t resolution = m_Options.tileResolution;
+    const uint32_t blocksPerTile = (resolution + ROW_BLOCK - 1) / ROW_BLOCK;
+    for (BakedTile& tile : outTiles)
+    {
+        tile.m_Resolution = resolution;
+        tile.m_RGBA.resize((size_t)resolution * resolution * 4);
+    }
+
+    parallelFor(&m_Pool, (uint32_t)outTiles.size() * blocksPerTile, [&](uint32_t item)
+    {
+        uint32_t tileIdx = item / blocksPerTile;
+        uint32_t rowStart = (item % blocksPerTile) * ROW_BLOCK;
+        BakeRows(outTiles[tileIdx], tileBounds[tileIdx], rowStart, std::min(rowStart + ROW_BLOCK, resolution));
+    });
+
+    return !outTiles.empty();
+}
+
+void TerrainBaker::SplitGeometry(std::vector<BakedTile>& outTiles, std::vector<Bounds>& outBounds) const
+{
+    const uint32_t tiles = std::max(m_Options.tilesPerSide, 1u);
+    const float sizeX = std::max(m_Bounds.m_MaxX - m_Bounds.m_MinX, 1.0f);
+    const float sizeZ = std::max(m_Bounds.m_MaxZ - m_Bounds.m_MinZ, 1.0f);
+
+    // assign each triangle to the tile its centroid lies in
+    std::vector<std::vector<uint32_t>> tileTriangles((size_t)tiles * tiles);
+    for (uint32_t i = 0; i + 2 < m_Terrain.m_NumIndices; i += 3)
+    {
+        const Vector3& a = m_Terrain.m_Vertices[m_Terrain.m_Indices[i]];
+        const Vector3& b = m_Terrain.m_Vertices[m_Terrain.m_Indices[i + 1]];
+        const Vector3& c = m_Terrain.m_Vertices[m_Terrain.m_Indices[i + 2]];
+        float cx = (a.m_X + b.m_X + c.m_X) / 3.0f;
+        float cz = (a.m_Z + b.m_Z + c.m_Z) / 3.0f;
+        uint32_t tx = std::min((uint32_t)std::max((cx - m_Bounds.m_MinX) / sizeX * tiles, 0.0f), tiles - 1);
+        uint32_t tz = std::min((uint32_t)std::max((cz - m_Bounds.m_MinZ) / sizeZ * tiles, 0.0f), tiles - 1);
+        tileTriangles[(size_t)tz * tiles + tx].emplace_back(i);
+    }
+
+    std::vector<int32_t> remap(m_Terrain.m_NumVertices);
+    for (uint32_t t = 0; t < tileTriangles.size(); ++t)
+    {
+        if (tileTriangles[t].empty())
+        {
+            continue;
+        }
+
+        BakedTile& tile = outTiles.emplace_back();
+        tile.m_Name = fmt::format("{0}_tile_{1}_{2}", m_Terrain.m_Name.c_str(), t % tiles, t / tiles);
+
+        Bounds& bounds = outBounds.emplace_back();
+        std::fill(remap.begin(), remap.end(), -1);
+        for (uint32_t tri : tileTriangles[t])
+        {
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                uint16_t idx = m_Terrain.m_Indices[tri + k];
+                if (remap[idx] < 0)
+                {
+                    remap[idx] = (int32_t)tile.m_Vertices.size();
+                    tile.m_Vertices.emplace_back(m_Terrain.m_Vertices[idx]);
+                    tile.m_Normals.emplace_back(idx < m_Terrain.m_NumNormals ? m_Terrain.m_Normals[idx] : Vector3{ 0.0f, 1.0f, 0.0f });
+                    bounds.Add(m_Terrain.m_Vertices[idx]);
+                }
+                tile.m_Indices.emplace_back((uint16_t)remap[idx]);
+            }
+        }
+
+        // the tile texture covers exactly the tile's own extent
+        const float tileSizeX = std::max(bounds.m_MaxX - bounds.m_MinX, 0.001f);
+        const float tileSizeZ = std::max(bounds.m_MaxZ - bounds.m_MinZ, 0.001f);
+        tile.m_UVs.resize(tile.m_Vertices.size());
+        for (size_t i = 0; i < tile.m_Vertices.size(); ++i)
+        {
+            tile.m_UVs[i].m_X = (tile.m_Vertices[i].m_X - bounds.m_MinX) / tileSizeX;
+            tile.m_UVs[i].m_Y = (tile.m_Vertices[i].m_Z - bounds.m_MinZ) / tileSizeZ;
+        }
+    }
+}
+
+void TerrainBaker::BakeRows(BakedTile& tile, const Bounds& bounds, uint32_t rowStart, uint32_t rowEnd) const
+{
+    const uint32_t resolution = tile.m_Resolution;
+    const uint32_t numLayers = (uint32_t)m_Layers.size();
+    const float blendMax = (float)(m_Terrain.m_BlendDim - 1);
+    const float sizeX = std::max(m_Bounds.m_MaxX - m_Bounds.m_MinX, 1.0f);
+    const float sizeZ = std::max(m_Bounds.m_MaxZ - m_Bounds.m_MinZ, 1.0f);
+
+    float weights[MAX_LAYERS];
+    uint32_t* dst = reinterpret_cast<uint32_t*>(tile.m_RGBA.data());
+
+    for (uint32_t row = rowStart; row < rowEnd; ++row)
+    {
+        const float z = bounds.m_MinZ + (row + 0.5f) / resolution * (bounds.m_MaxZ - bounds.m_MinZ);
+        const float bz = std::clamp((z - m_Bounds.m_MinZ) / sizeZ * blendMax, 0.0f, blendMax);
+        const uint32_t bz0 = (uint32_t)bz;
+        const uint32_t bz1 = std::min(bz0 + 1, m_Terrain.m_BlendDim - 1);
+        const float fz = bz - bz0;
+
+        float layerV = m_LayerOffsetV + z * m_LayerScaleV;
+        layerV -= std::floor(layerV);
+
+        for (uint32_t col = 0; col < resolution; ++col)
+        {
+            const float x = bounds.m_MinX + (col + 0.5f) / resolution * (bounds.m_MaxX - bounds.m_MinX);
+            const float bx = std::clamp((x - m_Bounds.m_MinX) / sizeX * blendMax, 0.0f, blendMax);
+            const uint32_t bx0 = (uint32_t)bx;
+            const uint32_t bx1 = std::min(bx0 + 1, m_Terrain.m_BlendDim - 1);
+            const float fx = bx - bx0;
+
+            // bilinear blend weights
+            const uint8_t* w00 = &m_Terrain.m_BlendMap[((size_t)bz0 * m_Terrain.m_BlendDim + bx0) * m_Terrain.m_NumLayers];
+            const uint8_t* w01 = &m_Terrain.m_BlendMap[((size_t)bz0 * m_Terrain.m_BlendDim + bx1) * m_Terrain.m_NumLayers];
+            const uint8_t* w10 = &m_Terrain.m_BlendMap[((size_t)bz1 * m_Terrain.m_BlendDim + bx0) * m_Terrain.m_NumLayers];
+            const uint8_t* w11 = &m_Terrain.m_BlendMap[((size_t)bz1 * m_Terrain.m_BlendDim + bx1) * m_Terrain.m_NumLayers];
+            float weightSum = 0.0f;
+            for (uint32_t l = 0; l < numLayers; ++l)
+            {
+                float top = w00[l] + (w01[l] - w00[l]) * fx;
+                float bottom = w10[l] + (w11[l] - w10[l]) * fx;
+                weights[l] = top + (bottom - top) * fz;
+                weightSum += weights[l];
+            }
+            if (weightSum <= 0.0f)
+            {
+                weights[0] = weightSum = 1.0f;
+                std::fill(weights + 1, weights + numLayers, 0.0f);
+            }
+
+            float layerU = m_LayerOffsetU + x * m_LayerScaleU;
+            layerU -= std::floor(layerU);
+
+#if LVL2GLTF_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            __m128 acc = _mm_setzero_ps();
+#else
+            float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+#endif
+            for (uint32_t l = 0; l < numLayers; ++l)
+            {
+                if (weights[l] <= 0.0f)
+                {
+                    continue;
+                }
+
+                const Layer& layer = m_Layers[l];
+                uint32_t u = std::min((uint32_t)(layerU * layer.m_Width), layer.m_Width - 1u);
+                uint32_t v = std::min((uint32_t)(layerV * layer.m_Height), layer.m_Height - 1u);
+                const uint8_t* texel = &layer.m_RGBA[((size_t)v * layer.m_Width + u) * 4];
+
+#if LVL2GLTF_SSE2
+                int32_t packed;
+                std::memcpy(&packed, texel, 4);
+                __m128i px = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(px), _mm_set1_ps(weights[l])));
+#else
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    acc[c] += texel[c] * weights[l];
+                }
+#endif
+            }
+
+#if LVL2GLTF_SSE2
+            __m128i result = _mm_cvtps_epi32(_mm_mul_ps(acc, _mm_set1_ps(1.0f / weightSum)));
+            result = _mm_packs_epi32(result, result);
+            result = _mm_packus_epi16(result, result);
+            uint32_t color = (uint32_t)_mm_cvtsi128_si32(result);
+#else
+            uint8_t rgba[4];
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                rgba[c] = (uint8_t)std::clamp(acc[c] / weightSum + 0.5f, 0.0f, 255.0f);
+            }
+            uint32_t color;
+            std::memcpy(&color, rgba, 4);
+#endif
+            // terrain is always opaque
+            reinterpret_cast<uint8_t*>(&color)[3] = 255;
+            dst[(size_t)row * resolution + col] = color;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "Common.h"
+#include "SourceData.h"
+#include "TaskPool.h"
+#include <cfloat>
+
+struct TerrainBakeOptions
+{
+    bool bEnabled = false;
+
+    // the terrain gets split into tilesPerSide x tilesPerSide tiles,
+    // each with its own tileResolution x tileResolution texture
+    uint32_t tilesPerSide = 4;
+    uint32_t tileResolution = 1024;
+};
+
+// Size of the RGBA data of all tiles of one baked terrain
+inline uint64_t bakedTerrainBytes(const TerrainBakeOptions& options)
+{
+    return (uint64_t)options.tilesPerSide * options.tilesPerSide * options.tileResolution * options.tileResolution * 4;
+}
+
+struct BakedTile
+{
+    std::string m_Name;
+
+    std::vector<Vector3> m_Vertices;
+    std::vector<Vector3> m_Normals;
+    std::vector<Vector2> m_UVs;
+    std::vector<uint16_t> m_Indices;
+
+    uint32_t m_Resolution = 0;
+    std::vector<uint8_t> m_RGBA;
+};
+
+// Bakes the blended terrain texture layers into one base color texture per tile,
+// so the terrain can be rendered with a single texture instead of a splat shader.
+class TerrainBaker
+{
+public:
+    // The tiles get baked on 'pool'
+    TerrainBaker(const SourceTerrain& terrain, const SourceScene& scene, const TerrainBakeOptions& options, TaskPool& pool);
+
+    bool Bake(std::vector<BakedTile>& outTiles);
+
+private:
+    struct Layer
+    {
+        uint16_t m_Width = 1;
+        uint16_t m_Height = 1;
+        const uint8_t* m_RGBA = nullptr;
+    };
+
+    struct Bounds
+    {
+        float m_MinX = FLT_MAX;
+        float m_MinZ = FLT_MAX;
+        float m_MaxX = -FLT_MAX;
+        float m_MaxZ = -FLT_MAX;
+
+        void Add(const Vector3& v);
+    };
+
+    void SplitGeometry(std::vector<BakedTile>& outTiles, std::vector<Bounds>& outBounds) const;
+    void BakeRows(BakedTile& tile, const Bounds& bounds, uint32_t rowStart, uint32_t rowEnd) const;
+
+    const SourceTerrain& m_Terrain;
+    const SourceScene& m_Scene;
+    TerrainBakeOptions m_Options;
+    TaskPool& m_Pool;
+
+    Bounds m_Bounds;
+
+    // world XZ -> layer UV, derived from the terrain's own UV mapping
+    float m_LayerScaleU = 1.0f;
+    float m_LayerOffsetU = 0.0f;
+    float m_LayerScaleV = 1.0f;
+    float m_LayerOffsetV = 0.0f;
+
+    std::vector<Layer> m_Layers;
+};
@@ -0,0 +1,75 @@
+#include "FastPNG.h"
+#include "TaskPool.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <stb_image.h>
+
+// Round trip check of the fast PNG encoder: encodes generated images of several sizes, including ones split
+// into many blocks compressed on different threads, decodes them again with stb_image and compares the pixels.
+// Exits with 1 if any of them don't match.
+int main()
+{
+    struct Case
+    {
+        uint32_t m_Width;
+        uint32_t m_Height;
+    };
+
+    // the larger ones get split into dozens of blocks
+    static const Case CASES[] = { { 1, 1 }, { 7, 3 }, { 256, 256 }, { 1000, 333 }, { 2048, 1024 }, { 4096, 600 } };
+
+    TaskPool pool(4);
+    std::mt19937 random(1138);
+    bool bSuccess = true;
+    for (const Case& c : CASES)
+    {
+        // noise, gradients and rows repeating each other, for literals as well as short and long matches
+        std::vector<uint8_t> rgba((size_t)c.m_Width * c.m_Height * 4);
+        for (uint32_t y = 0; y < c.m_Height; ++y)
+        {
+            for (uint32_t x = 0; x < c.m_Width; ++x)
+            {
+                uint8_t* pixel = &rgba[((size_t)y * c.m_Width + x) * 4];
+                switch ((y / 16 + x / 64) % 3)
+                {
+                    case 0:
+                        for (uint32_t i = 0; i < 4; ++i)
+                        {
+                            pixel[i] = (uint8_t)random();
+                        }
+                        break;
+                    case 1:
+                        pixel[0] = (uint8_t)x;
+                        pixel[1] = (uint8_t)y;
+                        pixel[2] = (uint8_t)(x + y);
+                        pixel[3] = 255;
+                        break;
+                    default:
+                        pixel[0] = (uint8_t)(x / 8 * 40);
+                        pixel[1] = 0;
+                        pixel[2] = 0;
+                        pixel[3] = (uint8_t)(x / 32 * 16);
+                        break;
+                }
+            }
+        }
+
+        std::vector<uint8_t> png;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        uint8_t* decoded = nullptr;
+        if (encodePNGFast(c.m_Width, c.m_Height, rgba.data(), png, &pool))
+        {
+            decoded = stbi_load_from_memory(png.data(), (int)png.size(), &width, &height, &channels, 4);
+        }
+
+        const bool bMatch = decoded != nullptr && (uint32_t)width == c.m_Width && (uint32_t)height == c.m_Height && std::memcmp(decoded, rgba.data(), rgba.size()) == 0;
+        stbi_image_free(decoded);
+        std::printf("%ux%u: %s\n", c.m_Width, c.m_Height, bMatch ? "OK" : "MISMATCH");
+        bSuccess &= bMatch;
+    }
+    return bSuccess ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <cstring>
+
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height) :
+    m_Width(width),
+    m_Height(height)
+{
+    m_Skyline.push_back({ 0, 0, width });
+}
+
+bool SkylinePacker::Insert(uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY)
+{
+    size_t bestIdx = SIZE_MAX;
+    uint32_t bestTop = UINT32_MAX;
+    uint32_t bestWidth = UINT32_MAX;
+    uint32_t bestY = 0;
+
+    for (size_t i = 0; i < m_Skyline.size(); ++i)
+    {
+        uint32_t y;
+        if (Fits(i, width, height, y))
+        {
+            // prefer the lowest top edge, then the narrowest skyline segment
+            uint32_t top = y + height;
+            if (top < bestTop || (top == bestTop && m_Skyline[i].m_Width < bestWidth))
+            {
+                bestIdx = i;
+                bestTop = top;
+                bestWidth = m_Skyline[i].m_Width;
+                bestY = y;
+            }
+        }
+    }
+
+    if (bestIdx == SIZE_MAX)
+    {
+        return false;
+    }
+
+    outX = m_Skyline[bestIdx].m_X;
+    outY = bestY;
+    AddLevel(bestIdx, outX, outY, width, height);
+    m_UsedArea += (uint64_t)width * height;
+    return true;
+}
+
+float SkylinePacker::GetOccupancy() const
+{
+    return (float)((double)m_UsedArea / ((double)m_Width * m_Height));
+}
+
+bool SkylinePacker::Fits(size_t nodeIdx, uint32_t width, uint32_t height, uint32_t& outY) const
+{
+    if (m_Skyline[nodeIdx].m_X + width > m_Width)
+    {
+        return false;
+    }
+
+    // the skyline always spans the whole bin width, so we
+    // can't run out of nodes before 'widthLeft' reaches zero
+    uint32_t y = m_Skyline[nodeIdx].m_Y;
+    int64_t widthLeft = width;
+    for (size_t i = nodeIdx; widthLeft > 0; ++i)
+    {
+        y = std::max(y, m_Skyline[i].m_Y);
+        if (y + height > m_Height)
+        {
+            return false;
+        }
+        widthLeft -= m_Skyline[i].m_Width;
+    }
+
+    outY = y;
+    return true;
+}
+
+void SkylinePacker::AddLevel(size_t nodeIdx, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    m_Skyline.insert(m_Skyline.begin() + nodeIdx, { x, y + height, width });
+
+    // cut away everything the new node now covers
+    for (size_t i = nodeIdx + 1; i < m_Skyline.size();)
+    {
+        const SkylineNode& prev = m_Skyline[i - 1];
+        SkylineNode& node = m_Skyline[i];
+        uint32_t prevEnd = prev.m_X + prev.m_Width;
+        if (node.m_X >= prevEnd)
+        {
+            break;
+        }
+
+        uint32_t shrink = prevEnd - node.m_X;
+        if (node.m_Width <= shrink)
+        {
+            m_Skyline.erase(m_Skyline.begin() + i);
+            continue;
+        }
+        node.m_X += shrink;
+        node.m_Width -= shrink;
+        break;
+    }
+
+    // merge neighbours of equal height
+    for (size_t i = 0; i + 1 < m_Skyline.size();)
+    {
+        if (m_Skyline[i].m_Y == m_Skyline[i + 1].m_Y)
+        {
+            m_Skyline[i].m_Width += m_Skyline[i + 1].m_Width;
+            m_Skyline.erase(m_Skyline.begin() + i + 1);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+
+AtlasPage::AtlasPage(uint32_t size) :
+    m_Size(size),
+    m_RGBA((size_t)size * size * 4, 0),
+    m_Packer(size, size)
+{
+
+}
+
+
+TextureAtlas::TextureAtlas(uint32_t pageSize, uint32_t padding) :
+    m_PageSize(pageSize),
+    m_Padding(padding)
+{
+
+}
+
+bool TextureAtlas::Add(uint32_t width, uint32_t height, const uint8_t* rgba, AtlasRect& outRect)
+{
+    uint32_t paddedWidth = width + m_Padding * 2;
+    uint32_t paddedHeight = height + m_Padding * 2;
+    if (paddedWidth > m_PageSize || paddedHeight > m_PageSize)
+    {
+        return false;
+    }
+
+    uint32_t x, y;
+    for (uint32_t i = 0; i < m_Pages.size(); ++i)
+    {
+        if (m_Pages[i].m_Packer.Insert(paddedWidth, paddedHeight, x, y))
+        {
+            outRect = { i, x + m_Padding, y + m_Padding, width, height };
+            Blit(m_Pages[i], outRect, rgba);
+            return true;
+        }
+    }
+
+    AtlasPage& page = m_Pages.emplace_back(m_PageSize);
+    page.m_Packer.Insert(paddedWidth, paddedHeight, x, y);
+    outRect = { (uint32_t)m_Pages.size() - 1, x + m_Padding, y + m_Padding, width, height };
+    Blit(page, outRect, rgba);
+    return true;
+}
+
+const std::vector<AtlasPage>& TextureAtlas::GetPages() const
+{
+    return m_Pages;
+}
+
+uint32_t TextureAtlas::GetPageSize() const
+{
+    return m_PageSize;
+}
+
+void TextureAtlas::Blit(AtlasPage& page, const AtlasRect& rect, const uint8_t* rgba)
+{
+    const size_t pagePitch = (size_t)page.m_Size * 4;
+    const size_t srcPitch = (size_t)rect.m_Width * 4;
+
+    for (uint32_t row = 0; row < rect.m_Height; ++row)
+    {
+        uint8_t* dst = &page.m_RGBA[(rect.m_Y + row) * pagePitch + (size_t)rect.m_X * 4];
+        std::memcpy(dst, rgba + row * srcPitch, srcPitch);
+
+        // replicate left and right edge pixels into the padding
+        for (uint32_t p = 1; p <= m_Padding; ++p)
+        {
+            std::memcpy(dst - (size_t)p * 4, dst, 4);
+            std::memcpy(dst + srcPitch + (size_t)(p - 1) * 4, dst + srcPitch - 4, 4);
+        }
+    }
+
+    // replicate top and bottom rows (including the already padded corners)
+    const size_t rowStart = (size_t)(rect.m_X - m_Padding) * 4;
+    const size_t rowLength = (size_t)(rect.m_Width + m_Padding * 2) * 4;
+    for (uint32_t p = 1; p <= m_Padding; ++p)
+    {
+        std::memcpy(&page.m_RGBA[(rect.m_Y - p) * pagePitch + rowStart], &page.m_RGBA[rect.m_Y * pagePitch + rowStart], rowLength);
+        std::memcpy(&page.m_RGBA[(rect.m_Y + rect.m_Height - 1 + p) * pagePitch + rowStart], &page.m_RGBA[(rect.m_Y + rect.m_Height - 1) * pagePitch + rowStart], rowLength);
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Skyline bottom-left rectangle packer.
+// Keeps track of the upper contour of all placed rectangles and puts each
+// new rectangle at the lowest position it fits in.
+class SkylinePacker
+{
+public:
+    SkylinePacker(uint32_t width, uint32_t height);
+
+    bool Insert(uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY);
+    float GetOccupancy() const;
+
+private:
+    struct SkylineNode
+    {
+        uint32_t m_X;
+        uint32_t m_Y;
+        uint32_t m_Width;
+    };
+
+    bool Fits(size_t nodeIdx, uint32_t width, uint32_t height, uint32_t& outY) const;
+    void AddLevel(size_t nodeIdx, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+    uint32_t m_Width;
+    uint32_t m_Height;
+    uint64_t m_UsedArea = 0;
+    std::vector<SkylineNode> m_Skyline;
+};
+
+struct AtlasRect
+{
+    uint32_t m_Page = 0;
+
+    // position and size of the actual image, excluding padding
+    uint32_t m_X = 0;
+    uint32_t m_Y = 0;
+    uint32_t m_Width = 0;
+    uint32_t m_Height = 0;
+};
+
+struct AtlasPage
+{
+    uint32_t m_Size;
+    std::vector<uint8_t> m_RGBA;
+    SkylinePacker m_Packer;
+
+    AtlasPage(uint32_t size);
+};
+
+// RGBA8 texture atlas consisting of one or more square pages.
+// Images are surrounded by a border of replicated edge pixels,
+// so bilinear filtering doesn't bleed into neighbouring images.
+class TextureAtlas
+{
+public:
+    TextureAtlas(uint32_t pageSize, uint32_t padding);
+
+    // For best results, add images sorted by descending height
+    bool Add(uint32_t width, uint32_t height, const uint8_t* rgba, AtlasRect& outRect);
+
+    const std::vector<AtlasPage>& GetPages() const;
+    uint32_t GetPageSize() const;
+
+private:
+    void Blit(AtlasPage& page, const AtlasRect& rect, const uint8_t* rgba);
+
+    uint32_t m_PageSize;
+    uint32_t m_Padding;
+    std::vector<AtlasPage> m_Pages;
+};
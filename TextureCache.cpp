@@ -0,0 +1,101 @@
+#include "TextureCache.h"
+#include "Common.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+
+TextureCache::TextureCache(const std::string& directory) :
+    m_Directory(directory)
+{
+    if (m_Directory.empty())
+    {
+        return;
+    }
+
+    std::error_code err;
+    fs::create_directories(m_Directory, err);
+    if (err)
+    {
+        LOG("Could not create cache directory '{0}': {1}. Texture caching is disabled!", m_Directory.c_str(), err.message().c_str());
+        m_Directory.clear();
+    }
+}
+
+bool TextureCache::IsEnabled() const
+{
+    return !m_Directory.empty();
+}
+
+bool TextureCache::TryGet(uint64_t key, std::vector<uint8_t>& outData)
+{
+    if (!IsEnabled())
+    {
+        return false;
+    }
+
+    std::ifstream file(GetPath(key), std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        m_NumMisses++;
+        return false;
+    }
+
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    outData.resize((size_t)size);
+    if (size <= 0 || !file.read(reinterpret_cast<char*>(outData.data()), size))
+    {
+        outData.clear();
+        m_NumMisses++;
+        return false;
+    }
+
+    m_NumHits++;
+    return true;
+}
+
+void TextureCache::Put(uint64_t key, const std::vector<uint8_t>& data)
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    // write to a temporary file first, so concurrent readers
+    // never get to see a partially written entry
+    std::string path = GetPath(key);
+    std::string tmpPath = fmt::format("{0}.{1:08x}.tmp", path, std::random_device()());
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(data.data()), data.size()))
+        {
+            LOG("Could not write texture cache entry '{0}'!", tmpPath.c_str());
+            return;
+        }
+    }
+
+    std::error_code err;
+    fs::rename(tmpPath, path, err);
+    if (err)
+    {
+        fs::remove(tmpPath, err);
+    }
+}
+
+uint32_t TextureCache::GetNumHits() const
+{
+    return m_NumHits;
+}
+
+uint32_t TextureCache::GetNumMisses() const
+{
+    return m_NumMisses;
+}
+
+std::string TextureCache::GetPath(uint64_t key) const
+{
+    return (fs::path(m_Directory) / fmt::format("{0:016x}.png", key)).u8string();
+}
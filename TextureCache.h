@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Content addressed on-disk cache for encoded images.
+// Each entry is a single file named after its 64 bit key, so several
+// converter processes can safely share one cache directory.
+class TextureCache
+{
+public:
+    TextureCache(const std::string& directory);
+
+    bool IsEnabled() const;
+    bool TryGet(uint64_t key, std::vector<uint8_t>& outData);
+    void Put(uint64_t key, const std::vector<uint8_t>& data);
+
+    uint32_t GetNumHits() const;
+    uint32_t GetNumMisses() const;
+
+private:
+    std::string GetPath(uint64_t key) const;
+
+    std::string m_Directory;
+    uint32_t m_NumHits = 0;
+    uint32_t m_NumMisses = 0;
+};
@@ -0,0 +1,393 @@
+#include "TextureStage.h"
+#include "Hash.h"
+#include "FastPNG.h"
+#include <algorithm>
+#include <queue>
+#include <stb_image_write.h>
+
+// border of replicated edge pixels around each atlas entry. Plenty for bilinear filtering, atlas pages get no mipmaps (see ESampler::Atlas)
+constexpr uint32_t ATLAS_PADDING = 4;
+
+// part of every cache key. change these whenever the encoded output changes!
+constexpr const char* STB_PNG_ENCODER_ID = "stb_image_write/png/1";
+constexpr const char* FAST_PNG_ENCODER_ID = "fastpng/1";
+
+
+void convertColor(const Color4u8& swbfColor, std::vector<double>& outColor)
+{
+    outColor.resize(4);
+    outColor[0] = swbfColor.m_Red / 255.0;
+    outColor[1] = swbfColor.m_Green / 255.0;
+    outColor[2] = swbfColor.m_Blue / 255.0;
+    outColor[3] = swbfColor.m_Alpha / 255.0;
+}
+
+bool encodePNGStb(uint32_t width, uint32_t height, const uint8_t* rgba, std::vector<uint8_t>& outPNG)
+{
+    outPNG.clear();
+    return stbi_write_png_to_func([](void* context, void* data, int size)
+    {
+        std::vector<uint8_t>& png = *static_cast<std::vector<uint8_t>*>(context);
+        png.insert(png.end(), static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + size);
+    }, &outPNG, (int)width, (int)height, 4, rgba, 0) != 0;
+}
+
+bool uvsInUnitRange(const Vector2* uvs, uint32_t count)
+{
+    // allow for a little imprecision from the munge process
+    constexpr float EPSILON = 0.001f;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (uvs[i].m_X < -EPSILON || uvs[i].m_X > 1.0f + EPSILON ||
+            uvs[i].m_Y < -EPSILON || uvs[i].m_Y > 1.0f + EPSILON)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool UVTransform::IsIdentity() const
+{
+    return m_OffsetU == 0.0f && m_OffsetV == 0.0f && m_ScaleU == 1.0f && m_ScaleV == 1.0f;
+}
+
+Vector2 UVTransform::Apply(const Vector2& uv) const
+{
+    Vector2 result;
+    result.m_X = m_OffsetU + std::clamp(uv.m_X, 0.0f, 1.0f) * m_ScaleU;
+    result.m_Y = m_OffsetV + std::clamp(uv.m_Y, 0.0f, 1.0f) * m_ScaleV;
+    return result;
+}
+
+
+TextureStage::TextureStage(tinygltf::Model& gltf, BinaryWriter& binary, const TextureStageOptions& options, TaskPool& pool) :
+    m_Gltf(gltf),
+    m_Binary(binary),
+    m_Options(options),
+    m_Atlas(options.atlasPageSize, ATLAS_PADDING),
+    m_Cache(options.cacheDir),
+    m_Pool(pool)
+{
+
+}
+
+void TextureStage::Reference(const SourceTexture* texture, bool bUVsInUnitRange)
+{
+    if (texture == nullptr)
+    {
+        return;
+    }
+
+    auto it = m_Textures.find(texture);
+    if (it == m_Textures.end())
+    {
+        it = m_Textures.emplace(texture, TextureEntry()).first;
+        it->second.m_Texture = texture;
+        m_ReferenceOrder.emplace_back(texture);
+    }
+    it->second.m_RefCount++;
+    it->second.m_bAtlasable &= bUVsInUnitRange;
+}
+
+void TextureStage::FitBudget(uint64_t reservedBytes)
+{
+    if (!m_Options.bTextures || m_Options.budgetBytes == 0)
+    {
+        return;
+    }
+
+    const uint64_t budgetBytes = m_Options.budgetBytes > reservedBytes ? m_Options.budgetBytes - reservedBytes : 0;
+    if (budgetBytes == 0)
+    {
+        LOG("Baked terrain tiles ({0:.1f} MB) take up the whole texture budget of {1:.1f} MB, all other textures get reduced as far as possible!",
+            reservedBytes / (1024.0 * 1024.0), m_Options.budgetBytes / (1024.0 * 1024.0));
+    }
+
+    struct Candidate
+    {
+        TextureEntry* m_Entry;
+        uint64_t m_Size;
+
+        // prefer big textures that are rarely used
+        double GetScore() const { return (double)m_Size / std::max(m_Entry->m_RefCount, 1u); }
+        bool operator<(const Candidate& other) const { return GetScore() < other.GetScore(); }
+    };
+
+    uint64_t totalSize = 0;
+    std::priority_queue<Candidate> candidates;
+    for (const SourceTexture* texture : m_ReferenceOrder)
+    {
+        TextureEntry& entry = m_Textures[texture];
+        uint16_t width, height;
+        const uint8_t* data;
+        if (GetImageData(entry, width, height, data))
+        {
+            uint64_t size = (uint64_t)width * height * 4;
+            totalSize += size;
+            candidates.push({ &entry, size });
+        }
+    }
+
+    const uint64_t originalSize = totalSize;
+    uint32_t numDropped = 0;
+    while (totalSize > budgetBytes && !candidates.empty())
+    {
+        Candidate c = candidates.top();
+        candidates.pop();
+
+        // not every texture comes with a full mip chain
+        uint16_t width, height;
+        const uint8_t* data;
+        c.m_Entry->m_MipLevel++;
+        if (!GetImageData(*c.m_Entry, width, height, data) || width == 0 || height == 0)
+        {
+            c.m_Entry->m_MipLevel--;
+            continue;
+        }
+
+        uint64_t size = (uint64_t)width * height * 4;
+        totalSize -= c.m_Size - size;
+        c.m_Size = size;
+        candidates.push(c);
+        numDropped++;
+    }
+
+    LOG("Texture budget: {0:.1f} MB -> {1:.1f} MB ({2} mip levels dropped)", originalSize / (1024.0 * 1024.0), totalSize / (1024.0 * 1024.0), numDropped);
+    if (totalSize > budgetBytes)
+    {
+        LOG("Could not fit textures into a budget of {0:.1f} MB, all remaining textures are at their smallest mip level!", budgetBytes / (1024.0 * 1024.0));
+    }
+}
+
+void TextureStage::Pack()
+{
+    if (!m_Options.bTextures || !m_Options.bAtlas)
+    {
+        return;
+    }
+
+    struct Candidate
+    {
+        TextureEntry* m_Entry;
+        std::string m_Name;
+        uint16_t m_Width;
+        uint16_t m_Height;
+        const uint8_t* m_Data;
+    };
+
+    std::vector<Candidate> candidates;
+    for (const SourceTexture* texture : m_ReferenceOrder)
+    {
+        TextureEntry& entry = m_Textures[texture];
+        if (!entry.m_bAtlasable)
+        {
+            continue;
+        }
+
+        Candidate c;
+        c.m_Entry = &entry;
+        c.m_Name = texture->m_Name;
+        if (!GetImageData(entry, c.m_Width, c.m_Height, c.m_Data))
+        {
+            continue;
+        }
+        if (c.m_Width > m_Options.atlasMaxSize || c.m_Height > m_Options.atlasMaxSize)
+        {
+            continue;
+        }
+        candidates.emplace_back(c);
+    }
+
+    // tallest first gives the skyline packer the least amount of gaps.
+    // the name is only there to keep the layout stable between runs
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+    {
+        if (a.m_Height != b.m_Height) return a.m_Height > b.m_Height;
+        if (a.m_Width != b.m_Width) return a.m_Width > b.m_Width;
+        return a.m_Name < b.m_Name;
+    });
+
+    uint32_t numPacked = 0;
+    for (const Candidate& c : candidates)
+    {
+        if (m_Atlas.Add(c.m_Width, c.m_Height, c.m_Data, c.m_Entry->m_AtlasRect))
+        {
+            c.m_Entry->m_bInAtlas = true;
+            numPacked++;
+        }
+    }
+
+    const std::vector<AtlasPage>& pages = m_Atlas.GetPages();
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        const AtlasPage& page = pages[i];
+        m_AtlasPageTextures.emplace_back(ExportImage(fmt::format("atlas_{0}", i), page.m_Size, page.m_Size, page.m_RGBA.data(), GetSampler(ESampler::Atlas)));
+        LOG("Packed atlas page {0} ({1}x{1}, {2}% occupied)", i, page.m_Size, (int)(page.m_Packer.GetOccupancy() * 100.0f));
+    }
+    if (!candidates.empty())
+    {
+        LOG("Packed {0} of {1} small textures into {2} atlas page(s)", numPacked, candidates.size(), pages.size());
+    }
+}
+
+int TextureStage::GetMaterial(const Color4u8& diffuseColor, const SourceTexture* texture, UVTransform& outUVTransform)
+{
+    outUVTransform = UVTransform();
+    int gltfTexture = ResolveTexture(texture, outUVTransform);
+
+    uint32_t colorKey =
+        (uint32_t)diffuseColor.m_Red << 24 |
+        (uint32_t)diffuseColor.m_Green << 16 |
+        (uint32_t)diffuseColor.m_Blue << 8 |
+        (uint32_t)diffuseColor.m_Alpha;
+
+    auto key = std::make_tuple(colorKey, gltfTexture);
+    auto it = m_Materials.find(key);
+    if (it != m_Materials.end())
+    {
+        return it->second;
+    }
+
+    tinygltf::Material& gltfMat = m_Gltf.materials.emplace_back();
+    convertColor(diffuseColor, gltfMat.pbrMetallicRoughness.baseColorFactor);
+    gltfMat.pbrMetallicRoughness.metallicFactor = 0.0f;
+    gltfMat.pbrMetallicRoughness.baseColorTexture.index = gltfTexture;
+
+    int matIdx = (int)m_Gltf.materials.size() - 1;
+    m_Materials.emplace(key, matIdx);
+    return matIdx;
+}
+
+int TextureStage::GetImageMaterial(const std::string& name, uint32_t width, uint32_t height, const uint8_t* rgba)
+{
+    tinygltf::Material& gltfMat = m_Gltf.materials.emplace_back();
+    gltfMat.name = name;
+    gltfMat.pbrMetallicRoughness.baseColorFactor = { 1.0, 1.0, 1.0, 1.0 };
+    gltfMat.pbrMetallicRoughness.metallicFactor = 0.0f;
+    gltfMat.pbrMetallicRoughness.baseColorTexture.index = ExportImage(name, width, height, rgba, GetSampler(ESampler::Clamp));
+    return (int)m_Gltf.materials.size() - 1;
+}
+
+bool TextureStage::GetImageData(const TextureEntry& entry, uint16_t& outWidth, uint16_t& outHeight, const uint8_t*& outData) const
+{
+    return entry.m_Texture->GetImageData(entry.m_MipLevel, outWidth, outHeight, outData);
+}
+
+std::unordered_map<const SourceTexture*, UVTransform> TextureStage::GetAtlasTransforms() const
+{
+    std::unordered_map<const SourceTexture*, UVTransform> transforms;
+    for (const auto& it : m_Textures)
+    {
+        if (it.second.m_bInAtlas)
+        {
+            transforms.emplace(it.first, GetAtlasTransform(it.second.m_AtlasRect));
+        }
+    }
+    return transforms;
+}
+
+UVTransform TextureStage::GetAtlasTransform(const AtlasRect& rect) const
+{
+    const float pageSize = (float)m_Atlas.GetPageSize();
+    UVTransform transform;
+    transform.m_OffsetU = rect.m_X / pageSize;
+    transform.m_OffsetV = rect.m_Y / pageSize;
+    transform.m_ScaleU = rect.m_Width / pageSize;
+    transform.m_ScaleV = rect.m_Height / pageSize;
+    return transform;
+}
+
+int TextureStage::ResolveTexture(const SourceTexture* texture, UVTransform& outUVTransform)
+{
+    if (!m_Options.bTextures || texture == nullptr)
+    {
+        return -1;
+    }
+
+    TextureEntry& entry = m_Textures[texture];
+    entry.m_Texture = texture;
+
+    if (entry.m_bInAtlas)
+    {
+        outUVTransform = GetAtlasTransform(entry.m_AtlasRect);
+        return m_AtlasPageTextures[entry.m_AtlasRect.m_Page];
+    }
+
+    if (entry.m_GltfTexture < 0)
+    {
+        uint16_t width, height;
+        const uint8_t* data;
+        if (!GetImageData(entry, width, height, data))
+        {
+            LOG("Could not decode texture '{0}'!", texture->m_Name.c_str());
+            return -1;
+        }
+        entry.m_GltfTexture = ExportImage(texture->m_Name, width, height, data, GetSampler(ESampler::Repeat));
+    }
+    return entry.m_GltfTexture;
+}
+
+int TextureStage::ExportImage(const std::string& name, uint32_t width, uint32_t height, const uint8_t* rgba, int sampler)
+{
+    const size_t size = (size_t)width * height * 4;
+    const uint64_t key = Hasher()
+        .Add(std::string(m_Options.bFastPNG ? FAST_PNG_ENCODER_ID : STB_PNG_ENCODER_ID))
+        .Add(width)
+        .Add(height)
+        .Add(rgba, size)
+        .Get();
+
+    std::vector<uint8_t> png;
+    if (!m_Cache.TryGet(key, png))
+    {
+        bool bEncoded = m_Options.bFastPNG ? encodePNGFast(width, height, rgba, png, &m_Pool) : encodePNGStb(width, height, rgba, png);
+        if (!bEncoded)
+        {
+            LOG("Could not encode image '{0}'!", name.c_str());
+            return -1;
+        }
+        m_Cache.Put(key, png);
+    }
+
+    // the encoded image goes straight into the binary buffer, pixel data is not kept
+    tinygltf::Image& img = m_Gltf.images.emplace_back();
+    img.name = name;
+    img.width = (int)width;
+    img.height = (int)height;
+    img.component = 4;
+    img.bits = 8;
+    img.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    img.mimeType = "image/png";
+    img.bufferView = m_Binary.AddBufferView(std::move(png), 0);
+
+    tinygltf::Texture& tex = m_Gltf.textures.emplace_back();
+    tex.name = name;
+    tex.source = (int)m_Gltf.images.size() - 1;
+    tex.sampler = sampler;
+    return (int)m_Gltf.textures.size() - 1;
+}
+
+int TextureStage::GetSampler(ESampler type)
+{
+    int& samplerIdx = m_Samplers[(int)type];
+    if (samplerIdx < 0)
+    {
+        tinygltf::Sampler& sampler = m_Gltf.samplers.emplace_back();
+        sampler.magFilter = TINYGLTF_TEXTURE_FILTER_LINEAR;
+        sampler.minFilter = type == ESampler::Atlas ? TINYGLTF_TEXTURE_FILTER_LINEAR : TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR;
+        sampler.wrapS = type == ESampler::Repeat ? TINYGLTF_TEXTURE_WRAP_REPEAT : TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE;
+        sampler.wrapT = sampler.wrapS;
+        samplerIdx = (int)m_Gltf.samplers.size() - 1;
+    }
+    return samplerIdx;
+}
+
+void TextureStage::LogStats() const
+{
+    if (m_Cache.IsEnabled())
+    {
+        LOG("Texture cache: {0} hits, {1} misses", m_Cache.GetNumHits(), m_Cache.GetNumMisses());
+    }
+}
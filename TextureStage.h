@@ -0,0 +1,113 @@
+#pragma once
+#include "Common.h"
+#include "BinaryWriter.h"
+#include "SourceData.h"
+#include "TaskPool.h"
+#include "TextureAtlas.h"
+#include "TextureCache.h"
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+struct UVTransform
+{
+    float m_OffsetU = 0.0f;
+    float m_OffsetV = 0.0f;
+    float m_ScaleU = 1.0f;
+    float m_ScaleV = 1.0f;
+
+    bool IsIdentity() const;
+    Vector2 Apply(const Vector2& uv) const;
+};
+
+struct TextureStageOptions
+{
+    // textures are only embedded into binary (.glb) outputs
+    bool bTextures = true;
+
+    // textures with both dimensions <= 'atlasMaxSize' get packed into shared atlas pages
+    bool bAtlas = false;
+    uint32_t atlasMaxSize = 128;
+    uint32_t atlasPageSize = 2048;
+
+    // if > 0, top mip levels get dropped until all referenced textures fit into this many bytes
+    uint64_t budgetBytes = 0;
+
+    // encoded images are looked up in / stored to this directory, if set
+    std::string cacheDir;
+
+    // use the fast parallel PNG encoder instead of stb_image_write, which gives smaller files, but is much slower
+    bool bFastPNG = true;
+};
+
+// Takes care of converting SWBF2 textures and materials into glTF.
+// Identical materials (same diffuse color, same glTF texture) are only emitted once.
+class TextureStage
+{
+public:
+    // Images get encoded on 'pool' as well
+    TextureStage(tinygltf::Model& gltf, BinaryWriter& binary, const TextureStageOptions& options, TaskPool& pool);
+
+    // Atlasing and budget only: announce every texture that is going to be used before calling FitBudget() and Pack().
+    // Textures used by any segment with UVs outside of [0, 1] (tiling) are never atlased.
+    void Reference(const SourceTexture* texture, bool bUVsInUnitRange);
+
+    // 'reservedBytes' of the budget are taken by images not referenced here, e.g. baked terrain tiles
+    void FitBudget(uint64_t reservedBytes = 0);
+    void Pack();
+
+    // Returns the glTF material index to use. If the texture got placed into an atlas,
+    // 'outUVTransform' holds the transformation that has to be applied to the segment UVs.
+    int GetMaterial(const Color4u8& diffuseColor, const SourceTexture* texture, UVTransform& outUVTransform);
+
+    // UV transformations of all atlased textures. Only valid after Pack(). Meant as a read only
+    // snapshot for worker threads, since GetMaterial() itself must only be called from one thread.
+    std::unordered_map<const SourceTexture*, UVTransform> GetAtlasTransforms() const;
+
+    // For generated images, e.g. baked terrain. Creates a new texture and plain white material for it.
+    int GetImageMaterial(const std::string& name, uint32_t width, uint32_t height, const uint8_t* rgba);
+
+    void LogStats() const;
+
+private:
+    struct TextureEntry
+    {
+        const SourceTexture* m_Texture = nullptr;
+        uint32_t m_RefCount = 0;
+        bool m_bAtlasable = true;
+        bool m_bInAtlas = false;
+        uint8_t m_MipLevel = 0;
+        AtlasRect m_AtlasRect;
+        int m_GltfTexture = -1;
+    };
+
+    bool GetImageData(const TextureEntry& entry, uint16_t& outWidth, uint16_t& outHeight, const uint8_t*& outData) const;
+    UVTransform GetAtlasTransform(const AtlasRect& rect) const;
+    int ResolveTexture(const SourceTexture* texture, UVTransform& outUVTransform);
+    enum class ESampler
+    {
+        Repeat,
+        Clamp,
+
+        // the gutter around atlas entries only covers the largest mip levels, so atlas pages aren't mipmapped
+        Atlas
+    };
+
+    int ExportImage(const std::string& name, uint32_t width, uint32_t height, const uint8_t* rgba, int sampler);
+    int GetSampler(ESampler type);
+
+    tinygltf::Model& m_Gltf;
+    BinaryWriter& m_Binary;
+    TextureStageOptions m_Options;
+    TextureAtlas m_Atlas;
+    TextureCache m_Cache;
+    TaskPool& m_Pool;
+
+    std::unordered_map<const SourceTexture*, TextureEntry> m_Textures;
+    std::vector<const SourceTexture*> m_ReferenceOrder;
+    std::vector<int> m_AtlasPageTextures;
+    std::map<std::tuple<uint32_t, int>, int> m_Materials;
+    int m_Samplers[3] = { -1, -1, -1 };
+};
+
+bool uvsInUnitRange(const Vector2* uvs, uint32_t count);
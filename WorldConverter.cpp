@@ -0,0 +1,712 @@
+#include "WorldConverter.h"
+#include "ModelConverter.h"
+#include "TerrainBaker.h"
+#include "Hash.h"
+#include <atomic>
+#include <filesystem>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+
+static void referenceTextures(const std::vector<ModelConverter::Job>& jobs, TextureStage& textures)
+{
+    for (const ModelConverter::Job& job : jobs)
+    {
+        for (const SourceSegment& segm : job.m_Model->m_Segments)
+        {
+            textures.Reference(segm.m_Texture, uvsInUnitRange(segm.m_UVs, segm.m_NumUVs));
+        }
+    }
+}
+
+static void initAsset(tinygltf::Model& gltf)
+{
+    gltf.asset.copyright = "https://github.com/Ben1138/LVL2glTF";
+    gltf.asset.generator = "LVL2glTF converter";
+    gltf.asset.minVersion = "2.0";
+    gltf.asset.version = "2.0";
+}
+
+static bool isCancelled(const ConvertOptions& options)
+{
+    return options.cancelled != nullptr && options.cancelled->load();
+}
+
+static bool isDone(const ConvertOptions& options, const std::string& fileOut)
+{
+    return options.journal != nullptr && options.journal->IsDone(options.journalKey, fileOut);
+}
+
+// one output file per layer, e.g. 'geo1.glb' -> 'geo1_geo1_conquest.glb'
+static std::string getLayerFile(const std::string& fileOut, const std::string& suffix)
+{
+    const fs::path outPath = fileOut;
+    fs::path p = outPath;
+    p.replace_filename(outPath.stem().u8string() + "_" + suffix + outPath.extension().u8string());
+    return p.u8string();
+}
+
+static size_t maxStagedModels(const ConvertOptions& options, const TaskPool& pool)
+{
+    // enough to keep every worker busy
+    return options.bLowMemory ? (size_t)pool.GetNumThreads() * 2 : 0;
+}
+
+// Converts the chosen layers into 'gltf', one scene per layer. Models of the world LVL always come first and
+// models of other LVLs (e.g. ingame.lvl) after them, so the output is the same no matter whether these were
+// loaded yet. If 'waitForRest' is set, only the world LVL is done loading yet. Models of other LVLs get looked up
+// after calling it, which happens right away with an atlas or a texture budget, since these need all textures upfront.
+static void convertLayers(
+    const SourceScene& scene,
+    const std::function<void()>& waitForRest,
+    const std::vector<bool>& chosenLayers,
+    const ConvertOptions& options,
+    TaskPool& pool,
+    tinygltf::Model& gltf,
+    BinaryWriter& binary,
+    TextureStage& textures
+)
+{
+    bool bPartiallyLoaded = (bool)waitForRest;
+    auto finishLoading = [&]()
+    {
+        if (bPartiallyLoaded)
+        {
+            waitForRest();
+            bPartiallyLoaded = false;
+        }
+    };
+
+    auto isShared = [&options](const std::string& geometryName)
+    {
+        return options.sharedGeometry != nullptr && options.sharedGeometry->count(geometryName) > 0;
+    };
+
+    // gather the models of all chosen layers first, so they get converted in one parallel batch
+    std::vector<ModelConverter::Job> jobs;
+    std::vector<ModelConverter::Job> otherJobs;
+    std::vector<std::string> otherGeometry;
+    std::unordered_set<std::string> visitedGeometry;
+    const std::vector<SourceLayer>& layers = scene.GetLayers();
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        if (!chosenLayers[i]) continue;
+
+        for (const SourceInstance& inst : layers[i].m_Instances)
+        {
+            const std::string& geometryName = inst.m_Geometry;
+            if (geometryName.empty() || !visitedGeometry.emplace(geometryName).second)
+            {
+                continue;
+            }
+            if (isShared(geometryName))
+            {
+                continue;
+            }
+
+            // while other LVLs are still loading, only the world LVL itself is safe to look into
+            const SourceModel* model = scene.FindWorldModel(geometryName);
+            if (model != nullptr)
+            {
+                jobs.push_back({ geometryName, model });
+            }
+            else
+            {
+                otherGeometry.emplace_back(geometryName);
+            }
+        }
+    }
+    auto findOtherModels = [&]()
+    {
+        finishLoading();
+        for (const std::string& geometryName : otherGeometry)
+        {
+            const SourceModel* model = scene.FindModel(geometryName);
+            if (model != nullptr)
+            {
+                otherJobs.push_back({ geometryName, model });
+            }
+        }
+        otherGeometry.clear();
+    };
+
+    if (options.textures.bTextures && (options.textures.bAtlas || options.textures.budgetBytes > 0))
+    {
+        // mip levels and the atlas layout have to be final before the first
+        // texture gets exported, so gather all textures of all models upfront
+        findOtherModels();
+        referenceTextures(jobs, textures);
+        referenceTextures(otherJobs, textures);
+
+        // baked terrain tiles have a fixed resolution, so every terrain baked takes its share off the budget
+        uint64_t bakedBytes = 0;
+        for (size_t i = 0; i < layers.size() && options.bake.bEnabled; ++i)
+        {
+            if (chosenLayers[i] && layers[i].m_Terrain != nullptr)
+            {
+                bakedBytes += bakedTerrainBytes(options.bake);
+            }
+        }
+        textures.FitBudget(bakedBytes);
+        textures.Pack();
+    }
+
+    ModelConverter converter(gltf, binary, textures, pool, maxStagedModels(options, pool), options.cancelled);
+    converter.Convert(jobs);
+
+    if (!otherGeometry.empty())
+    {
+        findOtherModels();
+    }
+    converter.Convert(otherJobs);
+
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        // skip unwanted layers
+        if (!chosenLayers[i]) continue;
+
+        const SourceLayer& layer = layers[i];
+        const SourceTerrain* terr = layer.m_Terrain.get();
+
+        tinygltf::Scene& gltfScene = gltf.scenes.emplace_back();
+        gltfScene.name = layer.m_Name;
+        int sceneIdx = (int)gltf.scenes.size() - 1;
+
+        if (terr != nullptr)
+        {
+            tinygltf::Node& terrNode = gltf.nodes.emplace_back();
+            terrNode.name = terr->m_Name;
+            gltf.scenes[sceneIdx].nodes.emplace_back((int)gltf.nodes.size() - 1);
+            terrNode.translation = { 0.0, 0.0, 0.0 };
+            terrNode.rotation = { 0.0, 0.0, 0.0, 1.0 };
+
+            tinygltf::Mesh& terrMesh = gltf.meshes.emplace_back();
+            int terrMeshIdx = (int)gltf.meshes.size() - 1;
+            terrMesh.name = terr->m_Name;
+            terrNode.mesh = terrMeshIdx;
+
+            std::vector<BakedTile> bakedTiles;
+            if (options.bake.bEnabled && options.textures.bTextures)
+            {
+                LOG("Baking terrain '{0}'...", terrMesh.name.c_str());
+                TerrainBaker baker(*terr, scene, options.bake, pool);
+                baker.Bake(bakedTiles);
+            }
+
+            // one primitive per baked tile, each with its own texture
+            for (BakedTile& tile : bakedTiles)
+            {
+                int gltfVertexBufferAccIdx = 0;
+                int gltfNormalBufferAccIdx = 0;
+                int gltfUVBufferAccIdx = 0;
+                int gltfIndexBufferAccIdx = 0;
+
+                copyBuffers(
+                    tile.m_Vertices.data(),
+                    (uint32_t)tile.m_Vertices.size(),
+                    tile.m_Normals.data(),
+                    (uint32_t)tile.m_Normals.size(),
+                    tile.m_UVs.data(),
+                    (uint32_t)tile.m_UVs.size(),
+                    tile.m_Indices.data(),
+                    (uint32_t)tile.m_Indices.size(),
+                    gltf,
+                    binary,
+                    gltfVertexBufferAccIdx,
+                    gltfNormalBufferAccIdx,
+                    gltfUVBufferAccIdx,
+                    gltfIndexBufferAccIdx
+                );
+
+                tinygltf::Primitive& prim = terrMesh.primitives.emplace_back();
+                prim.attributes =
+                {
+                    { "POSITION",   gltfVertexBufferAccIdx },
+                    { "NORMAL",     gltfNormalBufferAccIdx },
+                    { "TEXCOORD_0", gltfUVBufferAccIdx     },
+                };
+
+                prim.indices = gltfIndexBufferAccIdx;
+                prim.mode = TINYGLTF_MODE_TRIANGLES;
+                prim.material = textures.GetImageMaterial(tile.m_Name, tile.m_Resolution, tile.m_Resolution, tile.m_RGBA.data());
+
+                // the pixels are encoded now, no need to hold on to them
+                tile.m_RGBA = std::vector<uint8_t>();
+            }
+
+            if (bakedTiles.empty())
+            {
+                int gltfVertexBufferAccIdx = 0;
+                int gltfNormalBufferAccIdx = 0;
+                int gltfUVBufferAccIdx = 0;
+                int gltfIndexBufferAccIdx = 0;
+
+                copyBuffers(
+                    terr->m_Vertices,
+                    terr->m_NumVertices,
+                    terr->m_Normals,
+                    terr->m_NumNormals,
+                    terr->m_UVs,
+                    terr->m_NumUVs,
+                    terr->m_Indices,
+                    terr->m_NumIndices,
+                    gltf,
+                    binary,
+                    gltfVertexBufferAccIdx,
+                    gltfNormalBufferAccIdx,
+                    gltfUVBufferAccIdx,
+                    gltfIndexBufferAccIdx
+                );
+
+                UVTransform uvTransform;
+                int terrMatIdx = textures.GetMaterial({ 255, 255, 255, 255 }, nullptr, uvTransform);
+
+                tinygltf::Primitive& prim = terrMesh.primitives.emplace_back();
+                prim.attributes =
+                {
+                    { "POSITION",   gltfVertexBufferAccIdx },
+                    { "NORMAL",     gltfNormalBufferAccIdx },
+                    { "TEXCOORD_0", gltfUVBufferAccIdx     },
+                };
+
+                prim.indices = gltfIndexBufferAccIdx;
+                prim.mode = TINYGLTF_MODE_TRIANGLES;
+                prim.material = terrMatIdx;
+            }
+        }
+
+        for (const SourceInstance& inst : layer.m_Instances)
+        {
+            const std::string& geometryName = inst.m_Geometry;
+            if (geometryName.empty())
+            {
+                //LOG("Could not resolve 'GeometryName' property of instance '{0}' in world '{1}'", inst.m_Name.c_str(), layer.m_Name.c_str());
+                continue;
+            }
+
+            const bool bShared = isShared(geometryName);
+            int meshIdx = bShared ? -1 : converter.GetMeshIdx(geometryName);
+            if (!bShared && meshIdx < 0)
+            {
+                //LOG("Could not find model '{0}' for instance '{1}'!", geometryName.c_str(), inst.m_Name.c_str());
+                continue;
+            }
+
+            tinygltf::Node& node = gltf.nodes.emplace_back();
+            node.name = inst.m_Name;
+            node.mesh = meshIdx;
+            gltf.scenes[sceneIdx].nodes.emplace_back((int)gltf.nodes.size() - 1);
+
+            if (bShared)
+            {
+                // glTF has no way to reference a mesh of another file, so leave that to the importer
+                tinygltf::Value::Object extras;
+                extras["sharedFile"] = tinygltf::Value(options.sharedFile);
+                extras["sharedMesh"] = tinygltf::Value(geometryName);
+                node.extras = tinygltf::Value(extras);
+            }
+
+            const Vector3& pos = inst.m_Position;
+            const Vector4& rot = inst.m_Rotation;
+            node.translation = { pos.m_X, pos.m_Y, pos.m_Z };
+            node.rotation = { rot.m_X, rot.m_Y, rot.m_Z, rot.m_W };
+        }
+    }
+
+}
+
+// Converts the given models into 'gltf', with one node per mesh, so they can be instanced by name
+static void convertSharedModels(
+    const SourceScene& scene,
+    const std::vector<std::string>& geometryNames,
+    const ConvertOptions& options,
+    TaskPool& pool,
+    tinygltf::Model& gltf,
+    BinaryWriter& binary,
+    TextureStage& textures
+)
+{
+    std::vector<ModelConverter::Job> jobs;
+    for (const std::string& geometryName : geometryNames)
+    {
+        const SourceModel* model = scene.FindModel(geometryName);
+        if (model != nullptr)
+        {
+            jobs.push_back({ geometryName, model });
+        }
+    }
+
+    if (options.textures.bTextures && (options.textures.bAtlas || options.textures.budgetBytes > 0))
+    {
+        referenceTextures(jobs, textures);
+        textures.FitBudget();
+        textures.Pack();
+    }
+
+    ModelConverter converter(gltf, binary, textures, pool, maxStagedModels(options, pool), options.cancelled);
+    converter.Convert(jobs);
+
+    tinygltf::Scene& gltfScene = gltf.scenes.emplace_back();
+    gltfScene.name = "shared";
+    for (const ModelConverter::Job& job : jobs)
+    {
+        tinygltf::Node& node = gltf.nodes.emplace_back();
+        node.name = job.m_GeometryName;
+        node.mesh = converter.GetMeshIdx(job.m_GeometryName);
+        gltfScene.nodes.emplace_back((int)gltf.nodes.size() - 1);
+    }
+}
+
+// .glb outputs stream their binary data into a spill file next to the output file while converting.
+// .gltf outputs only do so with a memory limit, and get an external .bin file then.
+// Outputs which don't go to disk at all stay in memory.
+static std::string getSpillFile(const std::string& fileOut, const ConvertOptions& options)
+{
+    if (options.writeOutput)
+    {
+        return "";
+    }
+    return options.bGLTF && options.maxMemoryBytes == 0 ? "" : fileOut + ".bin.tmp";
+}
+
+// Nothing gets written once cancelled, the output would be incomplete
+static bool writeGltf(BinaryWriter& binary, const std::string& fileOut, const ConvertOptions& options)
+{
+    if (isCancelled(options))
+    {
+        LOG("Cancelled, not writing '{0}'.", fileOut.c_str());
+        return false;
+    }
+    LOG("Writing output file: {0}...", fileOut.c_str());
+    if (options.onProgress)
+    {
+        options.onProgress("writing", fileOut);
+    }
+    auto write = [&options, &fileOut](const uint8_t* data, size_t size)
+    {
+        return options.writeOutput(fileOut, data, size);
+    };
+    if (options.writeOutput ? !binary.Write(write, fileOut) : !binary.Write(fileOut, !options.bGLTF))
+    {
+        LOG("Writing '{0}' failed!", fileOut.c_str());
+        return false;
+    }
+    if (options.journal != nullptr)
+    {
+        options.journal->MarkDone(options.journalKey, fileOut);
+    }
+    if (options.onProgress)
+    {
+        options.onProgress("written", fileOut);
+    }
+    return true;
+}
+
+bool convertWorld(
+    const SourceScene& scene,
+    const std::function<void()>& waitForRest,
+    const std::vector<bool>& chosenLayers,
+    const ConvertOptions& options,
+    TaskPool& pool,
+    const std::string& fileOut
+)
+{
+    if (!options.bSplitLayers)
+    {
+        if (isDone(options, fileOut))
+        {
+            LOG("'{0}' is done already, skipping it.", fileOut.c_str());
+            return true;
+        }
+        tinygltf::Model gltf;
+        initAsset(gltf);
+        BinaryWriter binary(gltf, getSpillFile(fileOut, options), options.writeQueueBytes, options.maxMemoryBytes);
+        TextureStage textures(gltf, binary, options.textures, pool);
+        convertLayers(scene, waitForRest, chosenLayers, options, pool, gltf, binary, textures);
+        textures.LogStats();
+        if (options.onSourcesDone)
+        {
+            options.onSourcesDone();
+        }
+        return writeGltf(binary, fileOut, options);
+    }
+
+    if (waitForRest)
+    {
+        // the layer threads must not wait for loading on their own
+        waitForRest();
+    }
+
+    // models used by more than one of the chosen layers
+    const std::vector<SourceLayer>& layers = scene.GetLayers();
+    ConvertOptions layerOptions = options;
+    std::vector<std::string> sharedNames;
+    std::unordered_set<std::string> sharedGeometry;
+    if (options.bSharedModels)
+    {
+        std::unordered_map<std::string, uint32_t> numLayersUsing;
+        for (size_t i = 0; i < layers.size(); ++i)
+        {
+            if (!chosenLayers[i]) continue;
+
+            std::unordered_set<std::string> layerGeometry;
+            for (const SourceInstance& inst : layers[i].m_Instances)
+            {
+                if (!inst.m_Geometry.empty() && layerGeometry.emplace(inst.m_Geometry).second)
+                {
+                    if (++numLayersUsing[inst.m_Geometry] == 2)
+                    {
+                        sharedNames.emplace_back(inst.m_Geometry);
+                    }
+                }
+            }
+        }
+        sharedGeometry.insert(sharedNames.begin(), sharedNames.end());
+        layerOptions.sharedGeometry = &sharedGeometry;
+        layerOptions.sharedFile = fs::path(getLayerFile(fileOut, "shared")).filename().u8string();
+    }
+
+    // layers get converted and written concurrently, the model conversion of all of them shares the one task pool.
+    // Everything is loaded at this point, so the LVLs are only read from. Whoever finishes converting last
+    // releases the sources, the others may still be writing.
+    std::vector<std::function<void()>> layerJobs;
+    std::atomic<bool> bFailed = false;
+    std::atomic<size_t> numConverting = 0;
+    auto sourcesDone = [&]()
+    {
+        if (--numConverting == 0 && options.onSourcesDone)
+        {
+            options.onSourcesDone();
+        }
+    };
+    if (!sharedNames.empty())
+    {
+        layerJobs.emplace_back([&]()
+        {
+            const std::string sharedFile = getLayerFile(fileOut, "shared");
+            if (isDone(options, sharedFile))
+            {
+                LOG("'{0}' is done already, skipping it.", sharedFile.c_str());
+                sourcesDone();
+                return;
+            }
+            tinygltf::Model gltf;
+            initAsset(gltf);
+            BinaryWriter binary(gltf, getSpillFile(sharedFile, options), options.writeQueueBytes, options.maxMemoryBytes);
+            TextureStage textures(gltf, binary, layerOptions.textures, pool);
+            convertSharedModels(scene, sharedNames, layerOptions, pool, gltf, binary, textures);
+            textures.LogStats();
+            sourcesDone();
+            if (!writeGltf(binary, sharedFile, options))
+            {
+                bFailed = true;
+            }
+        });
+    }
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        if (!chosenLayers[i]) continue;
+
+        layerJobs.emplace_back([&, i]()
+        {
+            std::vector<bool> layerMask(layers.size(), false);
+            layerMask[i] = true;
+
+            const std::string layerOut = getLayerFile(fileOut, layers[i].m_Name);
+            if (isDone(options, layerOut))
+            {
+                LOG("'{0}' is done already, skipping it.", layerOut.c_str());
+                sourcesDone();
+                return;
+            }
+            tinygltf::Model gltf;
+            initAsset(gltf);
+            BinaryWriter binary(gltf, getSpillFile(layerOut, options), options.writeQueueBytes, options.maxMemoryBytes);
+            TextureStage textures(gltf, binary, layerOptions.textures, pool);
+            convertLayers(scene, nullptr, layerMask, layerOptions, pool, gltf, binary, textures);
+            textures.LogStats();
+            sourcesDone();
+            if (!writeGltf(binary, layerOut, options))
+            {
+                bFailed = true;
+            }
+        });
+    }
+    numConverting = layerJobs.size();
+
+    // the texture budget is meant for the whole export, so every file written gets an equal share of it
+    if (options.textures.budgetBytes > 0 && !layerJobs.empty())
+    {
+        layerOptions.textures.budgetBytes = std::max<uint64_t>(options.textures.budgetBytes / layerJobs.size(), 1);
+    }
+
+    if (options.bLowMemory)
+    {
+        // only one output model in memory at a time
+        for (const std::function<void()>& job : layerJobs)
+        {
+            job();
+        }
+        return !bFailed;
+    }
+
+    std::vector<std::thread> layerThreads;
+    for (const std::function<void()>& job : layerJobs)
+    {
+        layerThreads.emplace_back(job);
+    }
+    for (std::thread& thread : layerThreads)
+    {
+        thread.join();
+    }
+    return !bFailed;
+
+}
+
+bool convertStandalone(
+    const std::string& fileIn,
+    const Container* common,
+    const LVLContents* commonContents,
+    const LayerFilter& isChosen,
+    const ConvertOptions& options,
+    TaskPool& pool,
+    const std::string& fileOut
+)
+{
+    LVLContents contents;
+    if (!scanLVL(fileIn, contents))
+    {
+        return false;
+    }
+
+    std::vector<bool> chosenLayers(contents.m_Layers.size(), false);
+    uint32_t numChosen = 0;
+    for (size_t i = 0; i < contents.m_Layers.size(); ++i)
+    {
+        chosenLayers[i] = !isChosen || isChosen(contents.m_Layers[i].m_Name);
+        numChosen += chosenLayers[i] ? 1 : 0;
+    }
+
+    // nothing to load at all then
+    if (contents.m_Layers.empty())
+    {
+        LOG("Seems like '{0}' doesn't contain any world data! Skipping...", fileIn.c_str());
+        return true;
+    }
+    if (numChosen == 0)
+    {
+        LOG("None of the layers in '{0}' got chosen! Skipping...", fileIn.c_str());
+        return true;
+    }
+
+    ConvertOptions lvlOptions = options;
+    if (options.journal != nullptr)
+    {
+        lvlOptions.journalKey = Hasher(options.journalKey).Add(ConversionJournal::StampFile(fileIn)).Get();
+
+        // if the chosen layers don't share any models, there's no shared file and the LVL gets loaded
+        // again, just to find out. The layer files still get skipped then.
+        const bool bSharedDone = !options.bSharedModels || numChosen < 2 || isDone(lvlOptions, getLayerFile(fileOut, "shared"));
+        bool bAllDone = !options.bSplitLayers ? isDone(lvlOptions, fileOut) : bSharedDone;
+        for (size_t i = 0; i < contents.m_Layers.size() && options.bSplitLayers; ++i)
+        {
+            bAllDone &= !chosenLayers[i] || isDone(lvlOptions, getLayerFile(fileOut, contents.m_Layers[i].m_Name));
+        }
+        if (bAllDone)
+        {
+            LOG("'{0}' is done already, skipping it.", fileIn.c_str());
+            return true;
+        }
+    }
+    if (isCancelled(options))
+    {
+        return false;
+    }
+
+    std::unique_ptr<SourceScene> scene;
+    uint64_t cacheKey = 0;
+    if (options.parseCache != nullptr)
+    {
+        cacheKey = options.parseCache->GetKey(fileIn);
+        scene = options.parseCache->Load(cacheKey, options.textures.bTextures);
+    }
+
+    Level* lvl = nullptr;
+    if (scene == nullptr)
+    {
+        if (options.onProgress)
+        {
+            options.onProgress("loading", fileIn);
+        }
+
+        // a cache entry has to serve any layer selection
+        const std::vector<bool> layersToLoad = options.parseCache != nullptr ? std::vector<bool>(contents.m_Layers.size(), true) : chosenLayers;
+        // models which didn't change since they got cached don't have to be loaded again
+        std::unordered_map<std::string, uint64_t> modelHashes;
+        std::unordered_set<std::string> cachedNames;
+        std::unique_ptr<SourceScene> cachedModels;
+        if (options.parseCache != nullptr && hashModels(fileIn, modelHashes))
+        {
+            cachedModels = options.parseCache->LoadModels(modelHashes, cachedNames);
+        }
+        lvl = loadLayers(fileIn, contents, layersToLoad, commonContents, &cachedNames);
+        if (lvl == nullptr)
+        {
+            LOG("Loading '{0}' failed!", fileIn.c_str());
+            return false;
+        }
+        scene = std::make_unique<SourceScene>(lvl, common, std::move(cachedModels));
+        if (options.parseCache != nullptr)
+        {
+            options.parseCache->StoreModels(modelHashes, *scene);
+        }
+
+        // convert from the freshly stored entry, so the LVL doesn't have to stay loaded
+        std::unique_ptr<SourceScene> cached;
+        if (options.parseCache != nullptr && options.parseCache->Store(cacheKey, *scene, options.textures.bTextures))
+        {
+            cached = options.parseCache->Load(cacheKey, options.textures.bTextures);
+        }
+        if (cached != nullptr)
+        {
+            scene = std::move(cached);
+            Level::Destroy(lvl);
+            lvl = nullptr;
+        }
+    }
+    else
+    {
+        LOG("Read '{0}' from the parse cache.", fileIn.c_str());
+    }
+
+    if (options.onProgress)
+    {
+        options.onProgress("converting", fileIn);
+    }
+
+    if (options.bLowMemory)
+    {
+        lvlOptions.onSourcesDone = [&lvl, &options]()
+        {
+            if (lvl != nullptr)
+            {
+                Level::Destroy(lvl);
+                lvl = nullptr;
+            }
+            if (options.onSourcesDone)
+            {
+                options.onSourcesDone();
+            }
+        };
+    }
+
+    bool bSuccess = convertWorld(*scene, nullptr, matchLoadedLayers(contents, chosenLayers, scene->GetLayers()), lvlOptions, pool, fileOut);
+
+    if (lvl != nullptr)
+    {
+        Level::Destroy(lvl);
+    }
+    return bSuccess;
+}
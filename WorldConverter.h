@@ -0,0 +1,92 @@
+#pragma once
+#include "Common.h"
+#include "Journal.h"
+#include "LVLScanner.h"
+#include "ParseCache.h"
+#include "SourceData.h"
+#include "TaskPool.h"
+#include "TextureStage.h"
+#include "TerrainBaker.h"
+#include <atomic>
+#include <functional>
+#include <unordered_set>
+
+struct ConvertOptions
+{
+    TextureStageOptions textures;
+    TerrainBakeOptions bake;
+
+    // .gltf (text) instead of .glb output
+    bool bGLTF = false;
+
+    // one output file per layer, optionally with models used by several layers in a common file
+    bool bSplitLayers = false;
+    bool bSharedModels = false;
+
+    // how much converted data may wait for the writer thread
+    uint64_t writeQueueBytes = 64 * 1024 * 1024;
+
+    // binary data of an output file beyond this many bytes gets spilled into a temp file next to it.
+    // 0: .glb outputs spill everything right away, .gltf outputs keep everything in memory
+    uint64_t maxMemoryBytes = 0;
+
+    // trade speed for a lower peak memory: only read a few models ahead of the conversion,
+    // convert split layers one after another and release the LVLs as early as possible
+    bool bLowMemory = false;
+
+    // if set, standalone conversions read the LVLs from / store them to this cache, see convertStandalone()
+    const ParseCache* parseCache = nullptr;
+
+    // once this is set (e.g. by a signal handler), conversions stop as soon as possible and don't write any output
+    const std::atomic<bool>* cancelled = nullptr;
+
+    // if set, output files recorded as done under 'journalKey' get skipped and finished ones get recorded.
+    // convertStandalone() adds the input LVL to the key, so there it only has to cover the other settings.
+    ConversionJournal* journal = nullptr;
+    uint64_t journalKey = 0;
+
+    // if set, outputs don't get written to disk but handed to this in pieces, always as .glb and along with
+    // the path they would have been written to. Split layers get written concurrently, so this has to be thread safe.
+    std::function<bool(const std::string& file, const uint8_t* data, size_t size)> writeOutput;
+
+    // if set, gets called once the LVLs aren't read from anymore, before the output gets written
+    std::function<void()> onSourcesDone;
+
+    // if set, gets called with the stage ("loading", "converting", "writing", "written") and the file it is about.
+    // Split layers get written concurrently, so this has to be thread safe.
+    std::function<void(const std::string& stage, const std::string& file)> onProgress;
+
+    // instances of these geometry names don't get a mesh of their own,
+    // they just reference the mesh in 'sharedFile' via node extras
+    const std::unordered_set<std::string>* sharedGeometry = nullptr;
+    std::string sharedFile;
+};
+
+// Decides by name which layers get converted
+using LayerFilter = std::function<bool(const std::string& layerName)>;
+
+// Converts the chosen layers of 'scene' into 'fileOut', or with 'bSplitLayers' into one file per layer next to it.
+// If 'waitForRest' is set, only the world LVL is done loading yet. It gets called before anything else is looked up.
+bool convertWorld(
+    const SourceScene& scene,
+    const std::function<void()>& waitForRest,
+    const std::vector<bool>& chosenLayers,
+    const ConvertOptions& options,
+    TaskPool& pool,
+    const std::string& fileOut
+);
+
+// Loads 'fileIn' on its own, outside of any container, and converts it. Assets missing in 'fileIn' get
+// looked up in 'common', if given, with 'commonContents' being its scan. Without 'isChosen', all layers
+// get converted. Only what the chosen layers need gets loaded, see loadLayers(). With a parse cache, a hit
+// doesn't load anything at all, while a miss loads all layers and stores them for the next time.
+// With a journal, a LVL whose output files are all done doesn't get loaded either.
+bool convertStandalone(
+    const std::string& fileIn,
+    const Container* common,
+    const LVLContents* commonContents,
+    const LayerFilter& isChosen,
+    const ConvertOptions& options,
+    TaskPool& pool,
+    const std::string& fileOut
+);